@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+namespace beacon_lox
+{
+// 只分配不释放的 bump-pointer 内存池, AST 节点都从这里分配
+// 节点按分配顺序连续存放, 析构时整块归还, 不会逐个调用析构函数
+// 所以只能放平凡析构的类型, 这一点由 make() 的 static_assert 保证
+// 移动 Arena 不会改变已经分配的对象的地址
+class Arena
+{
+public:
+  Arena() = default;
+
+  Arena(const Arena &) = delete;
+  Arena &
+  operator=(const Arena &) = delete;
+
+  Arena(Arena &&other) noexcept
+    : chunks_(std::move(other.chunks_))
+    , cur_(std::exchange(other.cur_, nullptr))
+    , end_(std::exchange(other.end_, nullptr))
+    , used_(std::exchange(other.used_, 0))
+  {}
+
+  Arena &
+  operator=(Arena &&other) noexcept
+  {
+    if(this != &other)
+    {
+      chunks_ = std::move(other.chunks_);
+      cur_ = std::exchange(other.cur_, nullptr);
+      end_ = std::exchange(other.end_, nullptr);
+      used_ = std::exchange(other.used_, 0);
+    }
+    return *this;
+  }
+
+  ~Arena() = default;
+
+  template <typename T, typename... Args>
+  T *
+  make(Args &&...args)
+  {
+    static_assert(std::is_trivially_destructible_v<T>,
+                  "Arena never runs destructors");
+    void *p = allocate(sizeof(T), alignof(T));
+    return ::new(p) T(std::forward<Args>(args)...);
+  }
+
+  void *
+  allocate(std::size_t size, std::size_t align)
+  {
+    auto addr = reinterpret_cast<std::uintptr_t>(cur_);
+    std::size_t pad = (align - addr % align) % align;
+    if(cur_ == nullptr || size + pad > static_cast<std::size_t>(end_ - cur_))
+    {
+      grow(size + align);
+      addr = reinterpret_cast<std::uintptr_t>(cur_);
+      pad = (align - addr % align) % align;
+    }
+    std::byte *p = cur_ + pad;
+    cur_ = p + size;
+    used_ += size;
+    return p;
+  }
+
+  // 已经分配出去的字节数, 不含对齐的空隙
+  [[nodiscard]] std::size_t
+  bytes_used() const
+  {
+    return used_;
+  }
+
+  [[nodiscard]] std::size_t
+  chunk_count() const
+  {
+    return chunks_.size();
+  }
+
+private:
+  static constexpr std::size_t kChunkSize = 64 * 1024;
+
+  // 超过一块大小的对象单独占一块
+  void
+  grow(std::size_t at_least)
+  {
+    std::size_t size = std::max(kChunkSize, at_least);
+    // 不用 make_unique, 它会把整块清零
+    chunks_.emplace_back(new std::byte[size]);
+    cur_ = chunks_.back().get();
+    end_ = cur_ + size;
+  }
+
+  std::vector<std::unique_ptr<std::byte[]>> chunks_;
+  std::byte *cur_{nullptr};
+  std::byte *end_{nullptr};
+  std::size_t used_{0};
+};
+} // namespace beacon_lox
@@ -1,8 +1,11 @@
 #pragma once
 
+#include "arena.hh"
 #include "token.hh"
 #include "utils.hh"
 #include <any>
+#include <string>
+#include <type_traits>
 #include <variant>
 #include <memory>
 
@@ -114,13 +117,21 @@ class UnaryExpr;
 class BinaryExpr;
 class GroupingExpr;
 
-using LiteralExprPtr = std::unique_ptr<LiteralExpr>;
-using UnaryExprPtr = std::unique_ptr<UnaryExpr>;
-using BinaryExprPtr = std::unique_ptr<BinaryExpr>;
-using GroupingExprPtr = std::unique_ptr<GroupingExpr>;
+// 节点都分配在 Arena 里, Expr 只是不拥有所有权的指针
+using LiteralExprPtr = LiteralExpr *;
+using UnaryExprPtr = UnaryExpr *;
+using BinaryExprPtr = BinaryExpr *;
+using GroupingExprPtr = GroupingExpr *;
 using Expr =
     std::variant<LiteralExprPtr, UnaryExprPtr, BinaryExprPtr, GroupingExprPtr>;
 
+// 解析结果: 根节点和所有节点所在的 Arena, 节点随 arena 一起释放
+struct ParseResult
+{
+  Arena arena;
+  Expr expr;
+};
+
 class Visitor
 {
 public:
@@ -138,18 +149,27 @@ public:
 class ExprBase : private Uncopyabble
 {
 public:
-  virtual ~ExprBase() = default;
   virtual std::any
   accept(Visitor *visitor) = 0;
+
+protected:
+  // 节点不会通过基类指针释放, 析构函数保持平凡, 才能放进 Arena
+  ~ExprBase() = default;
 };
 
 class LiteralExpr : private ExprBase
 {
 public:
   Literal literal;
+  // 字符串字面量的驻留编号, 扫描时没有驻留则为 kNoSymbol
+  SymbolId symbol{kNoSymbol};
   explicit LiteralExpr(Literal _literal)
     : literal(_literal)
   {}
+  explicit LiteralExpr(Literal _literal, SymbolId _symbol)
+    : literal(_literal)
+    , symbol(_symbol)
+  {}
   std::any
   accept(Visitor *visitor) override
   {
@@ -164,6 +184,10 @@ public:
   Token token;
   BinaryOp op;
   Expr right;
+  // 哈希共享时被多个父节点引用, 见 node_cache.hh
+  bool shared{false};
+  // 类型推导证明了操作数都是数字, 求值时不用再检查, 见 type_inference.hh
+  bool numeric{false};
   explicit BinaryExpr(Expr _left, Token _token, BinaryOp _op, Expr _right)
     : left(std::move(_left))
     , token(_token)
@@ -183,6 +207,8 @@ public:
   Expr expr;
   Token token;
   UnaryOp op;
+  bool shared{false};
+  bool numeric{false};
 
   explicit UnaryExpr(Expr _expr, Token _token, UnaryOp _op)
     : expr(std::move(_expr))
@@ -212,60 +238,124 @@ public:
   }
 };
 
+// 被共享的运算节点的地址, 其他节点返回 nullptr
+// 遍历 DAG 的 pass 用它做键记住算过的节点, 每个共享的子树只处理一次
+inline const void *
+shared_node(const Expr &expr)
+{
+  if(auto *const *binary = std::get_if<BinaryExprPtr>(&expr))
+  {
+    return (*binary)->shared ? *binary : nullptr;
+  }
+  if(auto *const *unary = std::get_if<UnaryExprPtr>(&expr))
+  {
+    return (*unary)->shared ? *unary : nullptr;
+  }
+  return nullptr;
+}
+
+// 静态分派的访问者: 对 Expr 做一次 std::visit, 直接调用 Derived 的对应函数, 返回具体的类型 R
+// 没有虚函数调用, 也没有 std::any, 编译器可以把整个分派内联成一个 switch
+// Derived 提供 visit_literal, visit_unary, visit_binary, visit_grouping 四个函数
+// 动态的 Visitor 和 accept 保留下来兼容已有的代码, 新的遍历用这个
+template <typename Derived, typename R>
+class StaticVisitor
+{
+public:
+  R
+  visit(const Expr &expr)
+  {
+    auto &self = static_cast<Derived &>(*this);
+    return std::visit(
+        [&self](auto *node) -> R
+        {
+          using T = std::remove_pointer_t<decltype(node)>;
+          if constexpr(std::is_same_v<T, LiteralExpr>)
+          {
+            return self.visit_literal(node);
+          }
+          else if constexpr(std::is_same_v<T, UnaryExpr>)
+          {
+            return self.visit_unary(node);
+          }
+          else if constexpr(std::is_same_v<T, BinaryExpr>)
+          {
+            return self.visit_binary(node);
+          }
+          else
+          {
+            return self.visit_grouping(node);
+          }
+        },
+        expr);
+  }
+
+protected:
+  StaticVisitor() = default;
+  ~StaticVisitor() = default;
+};
+
+// 打印成 S 表达式, 递归的, 很大的树用 ast_dump.hh
+class ExprPrinter : public StaticVisitor<ExprPrinter, std::string>
+{
+public:
+  std::string
+  visit_literal(const LiteralExpr *literal)
+  {
+    return std::format("({})", literal->literal);
+  }
+
+  std::string
+  visit_unary(const UnaryExpr *unary)
+  {
+    return std::format(
+        "({} {} {})", unary->op, unary->token.get_lexeme(), visit(unary->expr));
+  }
+
+  std::string
+  visit_binary(const BinaryExpr *binary)
+  {
+    return std::format("({} {} {} {})",
+                       binary->op,
+                       binary->token.get_lexeme(),
+                       visit(binary->left),
+                       visit(binary->right));
+  }
+
+  std::string
+  visit_grouping(const GroupingExpr *grouping)
+  {
+    return std::format("(grouping {})", visit(grouping->expr));
+  }
+};
+
+// 动态接口的打印, 返回装着 std::string 的 std::any, 子节点交给 ExprPrinter
 class ExprVisitor : public Visitor
 {
 public:
   std::any
   literal_expr_visitor(LiteralExpr *literal) override
   {
-    return std::format("({})", literal->literal);
+    return printer_.visit_literal(literal);
   }
-  // std::any
-  // unary_expr_visitor(UnaryExpr *unary) override {
-  //! 这里的问题是,这里的表达式是一个 variant, 不是一个 Expr, 不能直接调用其 accept 方法
-  //! 这里的替代方案是可以使用一个 函数对象来.
-  //! 忘记了 virant 的 函数对象怎么使用了
-  //! 这里自己的问题, 还是想着根据不同的表达式类别去掉各自的函数....
-  // return std::format("({] {} {}})",
-  //                    unary->op,
-  //                    unary->token.get_lexeme(),
-  //                    std::visit([](const auto &value) -> std::string
-  //                               { return std::format("{}", value); },
-  //                               unary->expr));
   std::any
   unary_expr_visitor(UnaryExpr *unary) override
   {
-    return std::format(
-        "({} {} {})",
-        unary->op,
-        unary->token.get_lexeme(),
-        std::visit([this](const auto &value) -> std::string
-                   { return std::any_cast<std::string>(value->accept(this)); },
-                   unary->expr));
+    return printer_.visit_unary(unary);
   }
   std::any
   binary_expr_visitor(BinaryExpr *binary) override
   {
-    return std::format(
-        "({} {} {} {})",
-        binary->op,
-        binary->token.get_lexeme(),
-        std::visit([this](const auto &value) -> std::string
-                   { return std::any_cast<std::string>(value->accept(this)); },
-                   binary->left),
-        std::visit([this](const auto &value) -> std::string
-                   { return std::any_cast<std::string>(value->accept(this)); },
-                   binary->right));
+    return printer_.visit_binary(binary);
   }
   std::any
   grouping_expr_visitor(GroupingExpr *grouping) override
   {
-    return std::format(
-        "(grouping {})",
-        std::visit([this](const auto &value) -> std::string
-                   { return std::any_cast<std::string>(value->accept(this)); },
-                   grouping->expr));
+    return printer_.visit_grouping(grouping);
   }
+
+private:
+  ExprPrinter printer_;
 };
 
 } // namespace beacon_lox
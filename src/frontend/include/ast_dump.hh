@@ -0,0 +1,295 @@
+#pragma once
+
+#include "ast.hh"
+#include "token.hh"
+
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <format>
+#include <span>
+#include <string_view>
+#include <vector>
+
+
+namespace beacon_lox
+{
+// token 和 AST 的导出, 直接写到一个字符输出迭代器里
+// 比如 std::ostreambuf_iterator<char>(std::cout) 或者 std::back_inserter(string)
+// 不拼接中间的字符串, 每个字符只写一次, 输出的时间和节点数成正比
+// 用显式的栈遍历, 很深的树也不会栈溢出
+//
+// SEXPR 和 ExprVisitor 的输出完全相同, token 每行一个, 和测试程序里打印的格式相同
+// JSON 没有多余的空白:
+//   {"kind":"binary","op":"PLUS","lexeme":"+","left":...,"right":...}
+//   {"kind":"unary","op":"MINUS","lexeme":"-","operand":...}
+//   {"kind":"grouping","expr":...}
+//   {"kind":"literal","value":1}
+//   [{"type":"NUMBER","lexeme":"1","literal":1}, ...]
+enum class DumpFormat
+{
+  SEXPR,
+  JSON,
+};
+
+template <typename Out>
+class Dumper
+{
+public:
+  Dumper(Out out, DumpFormat format)
+    : out_(out)
+    , format_(format)
+  {}
+
+  Out
+  expr(const Expr &root)
+  {
+    // text 不为空时只输出这段文字, 否则展开 expr
+    struct Item
+    {
+      Expr expr;
+      std::string_view text;
+    };
+    const bool json = format_ == DumpFormat::JSON;
+    std::vector<Item> stack{{root, {}}};
+    while(!stack.empty())
+    {
+      Item item = stack.back();
+      stack.pop_back();
+      if(!item.text.empty())
+      {
+        put(item.text);
+        continue;
+      }
+      if(auto *const *binary = std::get_if<BinaryExprPtr>(&item.expr))
+      {
+        if(json)
+        {
+          put(R"({"kind":"binary","op":)");
+          quoted((*binary)->op);
+          put(R"(,"lexeme":)");
+          string((*binary)->token.get_lexeme());
+          put(R"(,"left":)");
+        }
+        else
+        {
+          out_ = std::format_to(out_,
+                                "({} {} ",
+                                (*binary)->op,
+                                (*binary)->token.get_lexeme());
+        }
+        stack.push_back({item.expr, json ? "}" : ")"});
+        stack.push_back({(*binary)->right, {}});
+        stack.push_back({item.expr, json ? R"(,"right":)" : " "});
+        stack.push_back({(*binary)->left, {}});
+      }
+      else if(auto *const *unary = std::get_if<UnaryExprPtr>(&item.expr))
+      {
+        if(json)
+        {
+          put(R"({"kind":"unary","op":)");
+          quoted((*unary)->op);
+          put(R"(,"lexeme":)");
+          string((*unary)->token.get_lexeme());
+          put(R"(,"operand":)");
+        }
+        else
+        {
+          out_ = std::format_to(out_,
+                                "({} {} ",
+                                (*unary)->op,
+                                (*unary)->token.get_lexeme());
+        }
+        stack.push_back({item.expr, json ? "}" : ")"});
+        stack.push_back({(*unary)->expr, {}});
+      }
+      else if(auto *const *group = std::get_if<GroupingExprPtr>(&item.expr))
+      {
+        put(json ? R"({"kind":"grouping","expr":)" : "(grouping ");
+        stack.push_back({item.expr, json ? "}" : ")"});
+        stack.push_back({(*group)->expr, {}});
+      }
+      else
+      {
+        const Literal &value = std::get<LiteralExprPtr>(item.expr)->literal;
+        put(json ? R"({"kind":"literal","value":)" : "(");
+        literal(value);
+        put(json ? "}" : ")");
+      }
+    }
+    return out_;
+  }
+
+  Out
+  tokens(std::span<const Token> tokens)
+  {
+    const bool json = format_ == DumpFormat::JSON;
+    if(json)
+    {
+      put("[");
+    }
+    for(std::size_t i = 0; i < tokens.size(); ++i)
+    {
+      const Token &token = tokens[i];
+      if(json)
+      {
+        put(i == 0 ? R"({"type":)" : R"(,{"type":)");
+        string(token_type_name(token.get_type()));
+        put(R"(,"lexeme":)");
+        string(token.get_lexeme());
+        put(R"(,"literal":)");
+        literal(token.get_literal());
+        put("}");
+      }
+      else
+      {
+        put(token_type_name(token.get_type()));
+        put(" ");
+        put(token.get_lexeme());
+        put(" ");
+        literal(token.get_literal());
+        put("\n");
+      }
+    }
+    if(json)
+    {
+      put("]\n");
+    }
+    return out_;
+  }
+
+private:
+  void
+  put(std::string_view text)
+  {
+    for(char c : text)
+    {
+      *out_++ = c;
+    }
+  }
+
+  template <typename Op>
+  void
+  quoted(Op op)
+  {
+    out_ = std::format_to(out_, "\"{}\"", op);
+  }
+
+  void
+  literal(const Literal &value)
+  {
+    std::visit(
+        [this](const auto &v)
+        {
+          using T = std::decay_t<decltype(v)>;
+          if constexpr(std::is_same_v<T, std::nullptr_t>)
+          {
+            put("null");
+          }
+          else if constexpr(std::is_same_v<T, bool>)
+          {
+            put(v ? "true" : "false");
+          }
+          else if constexpr(std::is_same_v<T, double>)
+          {
+            number(v);
+          }
+          else if(format_ == DumpFormat::JSON)
+          {
+            string(v);
+          }
+          else
+          {
+            put(v);
+          }
+        },
+        value);
+  }
+
+  // SEXPR 和 Literal 的 formatter 一样: {:g}, 没有小数点时补上 ".0"
+  // JSON 用最短的能精确还原的形式, 无穷大和 NaN 写成 null
+  void
+  number(double value)
+  {
+    char buffer[32];
+    if(format_ == DumpFormat::JSON)
+    {
+      if(!std::isfinite(value))
+      {
+        put("null");
+        return;
+      }
+      auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+      put({buffer, end});
+      return;
+    }
+    auto [end, ec] = std::to_chars(
+        buffer, buffer + sizeof(buffer), value, std::chars_format::general, 6);
+    std::string_view text{buffer, end};
+    put(text);
+    if(text.find('.') == std::string_view::npos)
+    {
+      put(".0");
+    }
+  }
+
+  void
+  string(std::string_view text)
+  {
+    constexpr char hex[] = "0123456789abcdef";
+    *out_++ = '"';
+    for(char c : text)
+    {
+      switch(c)
+      {
+        case '"':
+          put("\\\"");
+          break;
+        case '\\':
+          put("\\\\");
+          break;
+        case '\n':
+          put("\\n");
+          break;
+        case '\r':
+          put("\\r");
+          break;
+        case '\t':
+          put("\\t");
+          break;
+        default:
+          if(static_cast<unsigned char>(c) < 0x20)
+          {
+            put("\\u00");
+            *out_++ = hex[(c >> 4) & 0xf];
+            *out_++ = hex[c & 0xf];
+          }
+          else
+          {
+            *out_++ = c;
+          }
+      }
+    }
+    *out_++ = '"';
+  }
+
+  Out out_;
+  DumpFormat format_;
+};
+
+template <typename Out>
+Out
+dump_expr(const Expr &root, Out out, DumpFormat format = DumpFormat::SEXPR)
+{
+  return Dumper<Out>(out, format).expr(root);
+}
+
+template <typename Out>
+Out
+dump_tokens(std::span<const Token> tokens,
+            Out out,
+            DumpFormat format = DumpFormat::SEXPR)
+{
+  return Dumper<Out>(out, format).tokens(tokens);
+}
+} // namespace beacon_lox
@@ -0,0 +1,181 @@
+#pragma once
+
+#include "error.hh"
+#include "line_index.hh"
+#include "parser.hh"
+#include "scanner.hh"
+#include "source.hh"
+#include "symbol_table.hh"
+#include "token.hh"
+#include "token_stream.hh"
+
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+namespace beacon_lox
+{
+// 一个源文件从源码到 AST 的所有数据, 放在一起管理生命周期
+//   源码(Source) <- token 的 lexeme <- AST 节点里的 token 和字面量
+// 每个阶段的结果都是移动进来的, 没有拷贝:
+//   scan()  Scanner::take_tokens() 把 token vector 移交过来
+//   parse() Parser 用 TokenSpanCursor 借用这些 token, Arena 再移交过来
+// 移动 CompilationUnit 时, 源码, token, 节点和驻留的字符串的地址都不变, 已有的引用仍然有效
+// 驻留表是自己的, 和其它编译单元不共享, 所以整个对象可以交给另一个线程
+class CompilationUnit
+{
+public:
+  explicit CompilationUnit(Source source)
+    : source_(std::move(source))
+    , symbols_(std::make_unique<SymbolTable>())
+    , lines_(std::make_unique<LineIndex>(source_.view()))
+  {}
+
+  CompilationUnit(const CompilationUnit &) = delete;
+  CompilationUnit &
+  operator=(const CompilationUnit &) = delete;
+  CompilationUnit(CompilationUnit &&) noexcept = default;
+  CompilationUnit &
+  operator=(CompilationUnit &&) noexcept = default;
+  ~CompilationUnit() = default;
+
+  // 打开失败时 is_open() 返回 false
+  static CompilationUnit
+  open(const std::string &path)
+  {
+    return CompilationUnit{Source{path}};
+  }
+
+  static CompilationUnit
+  from_string(std::string_view contents)
+  {
+    return CompilationUnit{Source::from_string(contents)};
+  }
+
+  [[nodiscard]] bool
+  is_open() const
+  {
+    return source_.is_open();
+  }
+
+  // 扫描并驻留标识符和字符串, 重复调用不会重新扫描
+  void
+  scan()
+  {
+    if(!tokens_.empty())
+    {
+      return;
+    }
+    Scanner scanner{source_};
+    scanner.set_symbols(*symbols_);
+    tokens_ = scanner.take_tokens();
+  }
+
+  // 之后的 parse() 把结构相同的子树合并成一个节点, 见 node_cache.hh
+  void
+  enable_hash_consing()
+  {
+    hash_consing_ = true;
+  }
+
+  // 解析 ';' 分隔的表达式, 所有的语法错误都收集在 diagnostics() 里
+  // 没有错误时返回 true
+  bool
+  parse()
+  {
+    scan();
+    BasicParser<TokenSpanCursor> parser(tokens());
+    if(hash_consing_)
+    {
+      parser.enable_hash_consing();
+    }
+    ParseReport report = parser.parse_all();
+    arena_ = std::move(report.arena);
+    exprs_ = std::move(report.exprs);
+    diagnostics_ = std::move(report.diagnostics);
+    return diagnostics_.empty();
+  }
+
+  // 把收集到的语法错误按位置格式化到 error 里
+  void
+  report(Error &error) const
+  {
+    error.set_lines(*lines_);
+    for(const auto &diagnostic : diagnostics_)
+    {
+      error.error(diagnostic);
+    }
+  }
+
+  [[nodiscard]] std::string_view
+  source() const
+  {
+    return source_.view();
+  }
+
+  [[nodiscard]] std::span<const Token>
+  tokens() const
+  {
+    return tokens_;
+  }
+
+  [[nodiscard]] const std::vector<Expr> &
+  exprs() const
+  {
+    return exprs_;
+  }
+
+  // 优化遍(比如常量折叠)原地替换根节点, 新节点分配在 arena() 里
+  [[nodiscard]] std::vector<Expr> &
+  exprs()
+  {
+    return exprs_;
+  }
+
+  [[nodiscard]] Arena &
+  arena()
+  {
+    return arena_;
+  }
+
+  [[nodiscard]] const std::vector<Diagnostic> &
+  diagnostics() const
+  {
+    return diagnostics_;
+  }
+
+  [[nodiscard]] SymbolTable &
+  symbols()
+  {
+    return *symbols_;
+  }
+
+  [[nodiscard]] const LineIndex &
+  lines() const
+  {
+    return *lines_;
+  }
+
+  // AST 节点占用的字节数
+  [[nodiscard]] std::size_t
+  ast_bytes() const
+  {
+    return arena_.bytes_used();
+  }
+
+private:
+  // 声明顺序就是析构的逆序: AST 和 token 先于源码释放
+  Source source_;
+  // 驻留表和行首表会被解释器按地址引用, 放在堆上, 移动时地址不变
+  std::unique_ptr<SymbolTable> symbols_;
+  std::unique_ptr<LineIndex> lines_;
+  std::vector<Token> tokens_;
+  Arena arena_;
+  std::vector<Expr> exprs_;
+  std::vector<Diagnostic> diagnostics_;
+  bool hash_consing_{false};
+};
+} // namespace beacon_lox
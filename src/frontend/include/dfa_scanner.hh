@@ -0,0 +1,485 @@
+#pragma once
+
+#include "source.hh"
+#include "simd_scan.hh"
+#include "token.hh"
+#include "unicode.hh"
+#include "utils.hh"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+// 表驱动的词法分析器, 和 Scanner 产生同样的 token 序列
+// 字符分类表, 状态转移表, 关键字的完美哈希都在编译期生成
+namespace beacon_lox
+{
+namespace dfa
+{
+// 字符类别
+enum CharClass : std::uint8_t
+{
+  C_OTHER,
+  C_BLANK,
+  C_NEWLINE,
+  C_ALPHA,
+  C_DIGIT,
+  C_DOT,
+  C_QUOTE,
+  C_SLASH,
+  C_BANG,
+  C_EQUAL,
+  C_LESS,
+  C_GREATER,
+  C_LEFT_PAREN,
+  C_RIGHT_PAREN,
+  C_LEFT_BRACE,
+  C_RIGHT_BRACE,
+  C_COMMA,
+  C_MINUS,
+  C_PLUS,
+  C_SEMICOLON,
+  C_STAR,
+  CLASS_COUNT
+};
+
+// 状态, S_DEAD 表示没有可走的边了
+enum State : std::uint8_t
+{
+  S_DEAD,
+  S_START,
+  S_BLANK,
+  S_IDENT,
+  S_INT,
+  S_INT_DOT,
+  S_FRAC,
+  S_STRING,
+  S_STRING_END,
+  S_SLASH,
+  S_COMMENT,
+  S_BANG,
+  S_BANG_EQUAL,
+  S_EQUAL,
+  S_EQUAL_EQUAL,
+  S_LESS,
+  S_LESS_EQUAL,
+  S_GREATER,
+  S_GREATER_EQUAL,
+  S_LEFT_PAREN,
+  S_RIGHT_PAREN,
+  S_LEFT_BRACE,
+  S_RIGHT_BRACE,
+  S_COMMA,
+  S_DOT,
+  S_MINUS,
+  S_PLUS,
+  S_SEMICOLON,
+  S_STAR,
+  S_UNKNOWN,
+  STATE_COUNT
+};
+
+// 接受状态对应的动作
+enum class Action : std::uint8_t
+{
+  NONE,    // 不是接受状态
+  SKIP,    // 空白, 注释
+  TOKEN,   // 直接产生 accept_type 中的 token
+  IDENT,   // 标识符, 需要再查一次关键字
+  NUMBER,  // 数字字面量
+  STRING,  // 字符串字面量
+  UNKNOWN, // 不认识的字符
+};
+
+constexpr std::array<std::uint8_t, 256>
+make_char_classes()
+{
+  std::array<std::uint8_t, 256> classes{};
+  for(int c = 'a'; c <= 'z'; ++c)
+  {
+    classes[c] = C_ALPHA;
+  }
+  for(int c = 'A'; c <= 'Z'; ++c)
+  {
+    classes[c] = C_ALPHA;
+  }
+  for(int c = '0'; c <= '9'; ++c)
+  {
+    classes[c] = C_DIGIT;
+  }
+  classes['_'] = C_ALPHA;
+  classes[' '] = C_BLANK;
+  classes['\t'] = C_BLANK;
+  classes['\r'] = C_BLANK;
+  classes['\n'] = C_NEWLINE;
+  classes['.'] = C_DOT;
+  classes['"'] = C_QUOTE;
+  classes['/'] = C_SLASH;
+  classes['!'] = C_BANG;
+  classes['='] = C_EQUAL;
+  classes['<'] = C_LESS;
+  classes['>'] = C_GREATER;
+  classes['('] = C_LEFT_PAREN;
+  classes[')'] = C_RIGHT_PAREN;
+  classes['{'] = C_LEFT_BRACE;
+  classes['}'] = C_RIGHT_BRACE;
+  classes[','] = C_COMMA;
+  classes['-'] = C_MINUS;
+  classes['+'] = C_PLUS;
+  classes[';'] = C_SEMICOLON;
+  classes['*'] = C_STAR;
+  return classes;
+}
+
+using TransitionTable =
+    std::array<std::array<std::uint8_t, CLASS_COUNT>, STATE_COUNT>;
+
+constexpr TransitionTable
+make_transitions()
+{
+  TransitionTable table{};
+  auto &start = table[S_START];
+  start[C_OTHER] = S_UNKNOWN;
+  start[C_BLANK] = S_BLANK;
+  start[C_NEWLINE] = S_BLANK;
+  start[C_ALPHA] = S_IDENT;
+  start[C_DIGIT] = S_INT;
+  start[C_DOT] = S_DOT;
+  start[C_QUOTE] = S_STRING;
+  start[C_SLASH] = S_SLASH;
+  start[C_BANG] = S_BANG;
+  start[C_EQUAL] = S_EQUAL;
+  start[C_LESS] = S_LESS;
+  start[C_GREATER] = S_GREATER;
+  start[C_LEFT_PAREN] = S_LEFT_PAREN;
+  start[C_RIGHT_PAREN] = S_RIGHT_PAREN;
+  start[C_LEFT_BRACE] = S_LEFT_BRACE;
+  start[C_RIGHT_BRACE] = S_RIGHT_BRACE;
+  start[C_COMMA] = S_COMMA;
+  start[C_MINUS] = S_MINUS;
+  start[C_PLUS] = S_PLUS;
+  start[C_SEMICOLON] = S_SEMICOLON;
+  start[C_STAR] = S_STAR;
+
+  table[S_BLANK][C_BLANK] = S_BLANK;
+  table[S_BLANK][C_NEWLINE] = S_BLANK;
+
+  table[S_IDENT][C_ALPHA] = S_IDENT;
+  table[S_IDENT][C_DIGIT] = S_IDENT;
+
+  // 12. 后面不是数字时, 要退回到 12 处接受
+  table[S_INT][C_DIGIT] = S_INT;
+  table[S_INT][C_DOT] = S_INT_DOT;
+  table[S_INT_DOT][C_DIGIT] = S_FRAC;
+  table[S_FRAC][C_DIGIT] = S_FRAC;
+
+  // 字符串里除了引号之外都可以出现, 包括换行
+  for(int cls = 0; cls < CLASS_COUNT; ++cls)
+  {
+    table[S_STRING][cls] = S_STRING;
+  }
+  table[S_STRING][C_QUOTE] = S_STRING_END;
+
+  // 注释一直到换行为止, 换行本身作为下一个空白处理
+  table[S_SLASH][C_SLASH] = S_COMMENT;
+  for(int cls = 0; cls < CLASS_COUNT; ++cls)
+  {
+    table[S_COMMENT][cls] = S_COMMENT;
+  }
+  table[S_COMMENT][C_NEWLINE] = S_DEAD;
+
+  table[S_BANG][C_EQUAL] = S_BANG_EQUAL;
+  table[S_EQUAL][C_EQUAL] = S_EQUAL_EQUAL;
+  table[S_LESS][C_EQUAL] = S_LESS_EQUAL;
+  table[S_GREATER][C_EQUAL] = S_GREATER_EQUAL;
+  return table;
+}
+
+struct Accept
+{
+  Action action{Action::NONE};
+  TokenType type{TokenType::LOX_EOF};
+};
+
+constexpr std::array<Accept, STATE_COUNT>
+make_accepts()
+{
+  std::array<Accept, STATE_COUNT> accepts{};
+  accepts[S_BLANK] = {Action::SKIP, TokenType::LOX_EOF};
+  accepts[S_COMMENT] = {Action::SKIP, TokenType::LOX_EOF};
+  accepts[S_IDENT] = {Action::IDENT, TokenType::IDENTIFIER};
+  accepts[S_INT] = {Action::NUMBER, TokenType::NUMBER};
+  accepts[S_FRAC] = {Action::NUMBER, TokenType::NUMBER};
+  accepts[S_STRING_END] = {Action::STRING, TokenType::STRING};
+  accepts[S_UNKNOWN] = {Action::UNKNOWN, TokenType::LOX_EOF};
+  accepts[S_SLASH] = {Action::TOKEN, TokenType::SLASH};
+  accepts[S_BANG] = {Action::TOKEN, TokenType::BANS};
+  accepts[S_BANG_EQUAL] = {Action::TOKEN, TokenType::BANG_EQUAL};
+  accepts[S_EQUAL] = {Action::TOKEN, TokenType::EQUAL};
+  accepts[S_EQUAL_EQUAL] = {Action::TOKEN, TokenType::EQUAL_EQUAL};
+  accepts[S_LESS] = {Action::TOKEN, TokenType::LESS};
+  accepts[S_LESS_EQUAL] = {Action::TOKEN, TokenType::LESS_EQUAL};
+  accepts[S_GREATER] = {Action::TOKEN, TokenType::GREATER};
+  accepts[S_GREATER_EQUAL] = {Action::TOKEN, TokenType::GREATER_EQUAL};
+  accepts[S_LEFT_PAREN] = {Action::TOKEN, TokenType::LEFT_PAREN};
+  accepts[S_RIGHT_PAREN] = {Action::TOKEN, TokenType::RIGHT_PAREN};
+  accepts[S_LEFT_BRACE] = {Action::TOKEN, TokenType::LEFT_BRACE};
+  accepts[S_RIGHT_BRACE] = {Action::TOKEN, TokenType::RIGHT_BRACE};
+  accepts[S_COMMA] = {Action::TOKEN, TokenType::COMMA};
+  accepts[S_DOT] = {Action::TOKEN, TokenType::DOT};
+  accepts[S_MINUS] = {Action::TOKEN, TokenType::MINUS};
+  accepts[S_PLUS] = {Action::TOKEN, TokenType::PLUS};
+  accepts[S_SEMICOLON] = {Action::TOKEN, TokenType::SEMICOLON};
+  accepts[S_STAR] = {Action::TOKEN, TokenType::STAR};
+  return accepts;
+}
+
+inline constexpr auto kCharClasses = make_char_classes();
+inline constexpr auto kTransitions = make_transitions();
+inline constexpr auto kAccepts = make_accepts();
+
+// 关键字的完美哈希
+// key 由首字符, 尾字符和长度拼成, 16 个关键字的 key 两两不同
+// 编译期搜索一个乘数, 使 key * seed 混合后的低 5 位在 32 个槽里没有冲突
+struct Keyword
+{
+  std::string_view text;
+  TokenType type;
+};
+
+inline constexpr std::array<Keyword, 16> kKeywords{{
+    {"and", TokenType::AND},
+    {"class", TokenType::CLASS},
+    {"else", TokenType::ELSE},
+    {"false", TokenType::FALSE},
+    {"fun", TokenType::FUN},
+    {"for", TokenType::FOR},
+    {"if", TokenType::IF},
+    {"nil", TokenType::NIL},
+    {"or", TokenType::OR},
+    {"print", TokenType::PRINT},
+    {"return", TokenType::RETURN},
+    {"super", TokenType::SUPER},
+    {"this", TokenType::THIS},
+    {"true", TokenType::TRUE},
+    {"var", TokenType::VAR},
+    {"while", TokenType::WHILE},
+}};
+
+inline constexpr unsigned kKeywordBits = 5;
+inline constexpr std::size_t kKeywordSlots = 1U << kKeywordBits;
+inline constexpr std::size_t kMinKeywordLength = 2;
+inline constexpr std::size_t kMaxKeywordLength = 6;
+
+constexpr std::uint32_t
+keyword_key(std::string_view word)
+{
+  return static_cast<std::uint32_t>(static_cast<unsigned char>(word.front())) |
+         static_cast<std::uint32_t>(static_cast<unsigned char>(word.back()))
+             << 8 |
+         static_cast<std::uint32_t>(word.size()) << 16;
+}
+
+constexpr std::uint32_t
+keyword_slot(std::uint32_t key, std::uint32_t seed)
+{
+  std::uint32_t hash = key * seed;
+  hash ^= hash >> 15;
+  return hash & (kKeywordSlots - 1);
+}
+
+constexpr std::uint32_t
+find_keyword_seed()
+{
+  for(std::uint32_t seed = 1; seed < 100000; seed += 2)
+  {
+    std::array<bool, kKeywordSlots> used{};
+    bool ok = true;
+    for(const auto &kw : kKeywords)
+    {
+      auto slot = keyword_slot(keyword_key(kw.text), seed);
+      if(used[slot])
+      {
+        ok = false;
+        break;
+      }
+      used[slot] = true;
+    }
+    if(ok)
+    {
+      return seed;
+    }
+  }
+  return 0;
+}
+
+inline constexpr std::uint32_t kKeywordSeed = find_keyword_seed();
+static_assert(kKeywordSeed != 0, "no perfect hash seed for keywords");
+
+constexpr std::array<std::int8_t, kKeywordSlots>
+make_keyword_slots()
+{
+  std::array<std::int8_t, kKeywordSlots> slots{};
+  slots.fill(-1);
+  for(std::size_t i = 0; i < kKeywords.size(); ++i)
+  {
+    slots[keyword_slot(keyword_key(kKeywords[i].text), kKeywordSeed)] =
+        static_cast<std::int8_t>(i);
+  }
+  return slots;
+}
+
+inline constexpr auto kKeywordSlotTable = make_keyword_slots();
+
+// 一次哈希, 一次比较
+constexpr TokenType
+keyword_type(std::string_view word)
+{
+  if(word.size() < kMinKeywordLength || word.size() > kMaxKeywordLength)
+  {
+    return TokenType::IDENTIFIER;
+  }
+  auto idx = kKeywordSlotTable[keyword_slot(keyword_key(word), kKeywordSeed)];
+  if(idx < 0 || kKeywords[idx].text != word)
+  {
+    return TokenType::IDENTIFIER;
+  }
+  return kKeywords[idx].type;
+}
+
+static_assert(keyword_type("while") == TokenType::WHILE);
+static_assert(keyword_type("whale") == TokenType::IDENTIFIER);
+} // namespace dfa
+
+
+class DfaScanner : private Uncopyabble
+{
+public:
+  explicit DfaScanner(std::string contents)
+    : owned_(std::move(contents))
+    , source_(owned_)
+  {}
+
+  explicit DfaScanner(const Source &source)
+    : source_(source.view())
+  {}
+
+  std::vector<Token> &
+  scan_tokens()
+  {
+    const std::size_t size = source_.size();
+    std::size_t valid =
+        simd::validate_utf8(source_.data(), source_.data() + size);
+    if(valid != size)
+    {
+      std::cerr << "invalid utf-8 at byte " << valid << "\n";
+    }
+    while(cur_ < size)
+    {
+      scan_token();
+    }
+    tokens_.emplace_back(TokenType::LOX_EOF, source_.substr(size), "null");
+    return tokens_;
+  }
+
+private:
+  // 最长匹配: 一直走到死状态, 然后退回到最后一次经过的接受状态
+  void
+  scan_token()
+  {
+    const std::size_t start = cur_;
+    const std::size_t size = source_.size();
+    std::uint8_t state = dfa::S_START;
+    std::uint8_t last_state = dfa::S_DEAD;
+    std::size_t last_end = start;
+
+    for(std::size_t pos = start; pos < size; ++pos)
+    {
+      auto cls = dfa::kCharClasses[static_cast<unsigned char>(source_[pos])];
+      state = dfa::kTransitions[state][cls];
+      if(state == dfa::S_DEAD)
+      {
+        break;
+      }
+      if(dfa::kAccepts[state].action != dfa::Action::NONE)
+      {
+        last_state = state;
+        last_end = pos + 1;
+      }
+    }
+
+    if(last_state == dfa::S_DEAD)
+    {
+      // 只有没闭合的字符串会走到这里, 和 Scanner 一样直接丢弃到末尾
+      cur_ = size;
+      return;
+    }
+
+    cur_ = last_end;
+    auto lexeme = source_.substr(start, last_end - start);
+    const auto &accept = dfa::kAccepts[last_state];
+    switch(accept.action)
+    {
+      case dfa::Action::SKIP:
+        break;
+      case dfa::Action::TOKEN:
+        tokens_.emplace_back(accept.type, lexeme, nullptr);
+        break;
+      case dfa::Action::IDENT:
+        // 后面可能还有非 ASCII 的 XID_Continue, 这部分不在表里
+        cur_ += unicode::skip_identifier(source_.data() + cur_,
+                                         source_.data() + size);
+        lexeme = source_.substr(start, cur_ - start);
+        tokens_.emplace_back(dfa::keyword_type(lexeme), lexeme, nullptr);
+        break;
+      case dfa::Action::NUMBER:
+        tokens_.emplace_back(TokenType::NUMBER, lexeme, nullptr);
+        break;
+      case dfa::Action::STRING:
+        tokens_.emplace_back(TokenType::STRING,
+                             lexeme,
+                             lexeme.substr(1, lexeme.size() - 2));
+        break;
+      case dfa::Action::UNKNOWN:
+        if((static_cast<unsigned char>(lexeme.front()) & 0x80) != 0)
+        {
+          non_ascii(start);
+          break;
+        }
+        std::cerr << "unknown char:" << lexeme.front() << "\n";
+        break;
+      case dfa::Action::NONE:
+        break;
+    }
+  }
+
+  // 非 ASCII 字节不在字符分类表里, 和 Scanner 走同一个 Unicode 慢路径
+  void
+  non_ascii(std::size_t start)
+  {
+    const char *begin = source_.data() + start;
+    const char *end = source_.data() + source_.size();
+    if(std::size_t len = unicode::identifier_start(begin, end); len != 0)
+    {
+      cur_ = start + len + unicode::skip_identifier(begin + len, end);
+      tokens_.emplace_back(TokenType::IDENTIFIER,
+                           source_.substr(start, cur_ - start),
+                           nullptr);
+      return;
+    }
+    cur_ = start + unicode::skip_unknown(begin, end);
+    std::cerr << "unknown char:" << source_.substr(start, cur_ - start)
+              << "\n";
+  }
+
+  std::string owned_;
+  std::string_view source_;
+  unsigned long int cur_{0};
+  std::vector<Token> tokens_;
+};
+} // namespace beacon_lox
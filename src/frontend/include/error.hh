@@ -4,6 +4,7 @@
 #include <string>
 #include <format>
 
+#include "line_index.hh"
 #include "token.hh"
 
 
@@ -16,6 +17,14 @@ enum class LoxStatus
 };
 
 
+// 解析时收集的一条错误, 不抛异常, 由调用方决定什么时候报告
+struct Diagnostic
+{
+  Token token;
+  std::string message;
+};
+
+
 class Error
 {
 public:
@@ -27,23 +36,30 @@ public:
       , _token(token)
     {}
   };
+  // token 的行号和列号通过这份源码的行首表换算
   void
-  error(const long unsigned int line, const std::string_view msg)
+  set_lines(const LineIndex &lines)
   {
-    report(line, "", msg);
+    lines_ = &lines;
+  }
+
+  void
+  error(const Location location, const std::string_view msg)
+  {
+    report(location, "", msg);
   }
   void
   error(const Token &token, const std::string_view msg)
   {
+    Location location = lines_ != nullptr ? lines_->locate(token)
+                                          : Location{0, 0};
     if(token.get_type() == TokenType::LOX_EOF)
     {
-      report(token.get_line(), " at end", msg);
+      report(location, " at end", msg);
       return;
     }
 
-    report(token.get_line(),
-           " at '" + std::string(token.get_lexeme()) + "'",
-           msg);
+    report(location, " at '" + std::string(token.get_lexeme()) + "'", msg);
   }
 
   void
@@ -52,21 +68,45 @@ public:
     error(runtime_error._token, runtime_error.what());
   }
 
+  void
+  error(const Diagnostic &diagnostic)
+  {
+    error(diagnostic.token, diagnostic.message);
+  }
+
+  // 格式化好的错误, 按报告的顺序
+  [[nodiscard]] const std::vector<std::string> &
+  errors() const
+  {
+    return errs_;
+  }
+
+  [[nodiscard]] bool
+  had_error() const
+  {
+    return !errs_.empty();
+  }
+
 
 private:
   void
-  report(const long unsigned int line,
+  report(const Location location,
          const std::string_view where,
          const std::string_view msg)
   {
-    errs_.emplace_back(
-        std::format("[line {}] Error{}: {}\n", line, where, msg));
+    errs_.emplace_back(std::format("[line {}, column {}] Error{}: {}\n",
+                                   location.line,
+                                   location.column,
+                                   where,
+                                   msg));
   }
   std::vector<std::string> errs_;
+  const LineIndex *lines_{nullptr};
   LoxStatus status_{LoxStatus::OK};
 };
 
 // 全局错误实例（可选，方便使用宏）
+// 多线程时不要用它, 每个 CompilationUnit 的错误由调用方用自己的 Error 报告
 extern Error g_error;
 
 } // namespace beacon_lox
\ No newline at end of file
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+
+namespace beacon_lox
+{
+// std::expected 要到 C++23 才有, 这里只实现用得到的部分
+//   Expected<Expr, Diagnostic> r = Unexpected{Diagnostic{...}};
+//   if(!r) { use(r.error()); }
+template <typename E>
+struct Unexpected
+{
+  E value;
+};
+
+template <typename E>
+Unexpected(E) -> Unexpected<E>;
+
+template <typename T, typename E>
+class Expected
+{
+public:
+  template <typename U = T,
+            typename = std::enable_if_t<std::is_constructible_v<T, U &&>>>
+  Expected(U &&value)
+    : storage_(std::in_place_index<0>, std::forward<U>(value))
+  {}
+
+  template <typename G>
+  Expected(Unexpected<G> error)
+    : storage_(std::in_place_index<1>, std::move(error.value))
+  {}
+
+  [[nodiscard]] bool
+  has_value() const
+  {
+    return storage_.index() == 0;
+  }
+
+  explicit
+  operator bool() const
+  {
+    return has_value();
+  }
+
+  T &
+  value() &
+  {
+    return std::get<0>(storage_);
+  }
+  const T &
+  value() const &
+  {
+    return std::get<0>(storage_);
+  }
+  T &&
+  value() &&
+  {
+    return std::get<0>(std::move(storage_));
+  }
+
+  T &
+  operator*() &
+  {
+    return value();
+  }
+  T &&
+  operator*() &&
+  {
+    return std::move(*this).value();
+  }
+
+  T *
+  operator->()
+  {
+    return &value();
+  }
+
+  E &
+  error() &
+  {
+    return std::get<1>(storage_);
+  }
+  const E &
+  error() const &
+  {
+    return std::get<1>(storage_);
+  }
+  E &&
+  error() &&
+  {
+    return std::get<1>(std::move(storage_));
+  }
+
+private:
+  // 下标 0 是值, 1 是错误, T 和 E 可以是同一个类型
+  std::variant<T, E> storage_;
+};
+} // namespace beacon_lox
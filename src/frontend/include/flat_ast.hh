@@ -0,0 +1,339 @@
+#pragma once
+
+#include "ast.hh"
+#include "symbol_table.hh"
+#include "token.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+namespace beacon_lox
+{
+enum class FlatKind : std::uint8_t
+{
+  NIL,
+  FALSE,
+  TRUE,
+  NUMBER,
+  STRING,
+  UNARY,
+  BINARY,
+  GROUPING,
+};
+
+// 不在源码里的位置, 比如 nil/true/false/数字字面量(它们的 lexeme 没有保存在树里)
+inline constexpr std::uint32_t kNoOffset =
+    std::numeric_limits<std::uint32_t>::max();
+
+// 一个节点 16 字节, 不带 Token, 报错位置用 offset 通过 LineIndex 换算
+// NUMBER: lhs 是数字池的下标
+// STRING: lhs 是字符串池的下标, rhs 是驻留编号(可能是 kNoSymbol, 求值时再驻留)
+// UNARY/GROUPING: lhs 是子节点下标
+// BINARY: lhs/rhs 是左右子节点下标
+// op 是运算符的 TokenType, offset 是运算符(字符串字面量则是前引号)在源码中的偏移
+struct FlatNode
+{
+  FlatKind kind;
+  std::uint8_t op;
+  std::uint32_t lhs;
+  std::uint32_t rhs;
+  std::uint32_t offset;
+};
+
+static_assert(sizeof(FlatNode) == 16);
+
+// 后序排列的扁平 AST, 所有节点在一个连续数组里
+// 子节点一定排在父节点前面, 每个根节点都排在它的整棵子树之后, 所以求值只需要从前往后扫一遍
+// 哈希共享的 DAG 不会展开成树: 同一个根节点下共享的运算节点只有一份, 被多个父节点引用
+// 可以有多个根节点(parse_all 的多个表达式), 按源码中的顺序排列
+// 所有数据都是平凡类型的数组, 字符串的内容也拷贝进了 chars, 不依赖源码和驻留表
+// 可以自己持有这些数组(from_tree), 也可以直接引用外部的内存(view), 比如映射进来的缓存文件
+class FlatAst
+{
+public:
+  // 字符串在 chars 里的位置
+  struct StringRef
+  {
+    std::uint32_t offset;
+    std::uint32_t length;
+  };
+
+  FlatAst() = default;
+
+  // 数组的视图指向自己持有的 vector, 拷贝之后会指向原来的对象, 所以只能移动
+  FlatAst(const FlatAst &) = delete;
+  FlatAst &
+  operator=(const FlatAst &) = delete;
+  FlatAst(FlatAst &&) noexcept = default;
+  FlatAst &
+  operator=(FlatAst &&) noexcept = default;
+  ~FlatAst() = default;
+
+  // source 是解析时用的源码, 用来把 token 的 lexeme 换算成偏移
+  static FlatAst
+  from_tree(const Expr &root, std::string_view source)
+  {
+    return from_trees(std::span<const Expr>{&root, 1}, source);
+  }
+
+  static FlatAst
+  from_trees(std::span<const Expr> roots, std::string_view source)
+  {
+    FlatAst ast;
+    ast.source_ = source;
+    for(const Expr &root : roots)
+    {
+      ast.flatten(root);
+      ast.owned_roots_.push_back(
+          static_cast<std::uint32_t>(ast.owned_nodes_.size() - 1));
+    }
+    ast.nodes_ = ast.owned_nodes_;
+    ast.roots_ = ast.owned_roots_;
+    ast.numbers_ = ast.owned_numbers_;
+    ast.strings_ = ast.owned_strings_;
+    ast.chars_ = {ast.owned_chars_.data(), ast.owned_chars_.size()};
+    return ast;
+  }
+
+  // 不拷贝, 所有的内存都要比返回的 FlatAst 活得久
+  static FlatAst
+  view(std::span<const FlatNode> nodes,
+       std::span<const std::uint32_t> roots,
+       std::span<const double> numbers,
+       std::span<const StringRef> strings,
+       std::string_view chars,
+       std::string_view source)
+  {
+    FlatAst ast;
+    ast.nodes_ = nodes;
+    ast.roots_ = roots;
+    ast.numbers_ = numbers;
+    ast.strings_ = strings;
+    ast.chars_ = chars;
+    ast.source_ = source;
+    return ast;
+  }
+
+  [[nodiscard]] std::span<const FlatNode>
+  nodes() const
+  {
+    return nodes_;
+  }
+
+  // 每个根节点的下标, 递增
+  [[nodiscard]] std::span<const std::uint32_t>
+  roots() const
+  {
+    return roots_;
+  }
+
+  [[nodiscard]] std::span<const double>
+  numbers() const
+  {
+    return numbers_;
+  }
+
+  [[nodiscard]] std::span<const StringRef>
+  strings() const
+  {
+    return strings_;
+  }
+
+  [[nodiscard]] std::string_view
+  chars() const
+  {
+    return chars_;
+  }
+
+  [[nodiscard]] std::size_t
+  size() const
+  {
+    return nodes_.size();
+  }
+
+  [[nodiscard]] double
+  number(const FlatNode &node) const
+  {
+    return numbers_[node.lhs];
+  }
+
+  // 字符串内容, 不含引号
+  [[nodiscard]] std::string_view
+  string(const FlatNode &node) const
+  {
+    const StringRef &ref = strings_[node.lhs];
+    return chars_.substr(ref.offset, ref.length);
+  }
+
+  [[nodiscard]] std::string_view
+  source() const
+  {
+    return source_;
+  }
+
+  // 实际占用的字节数, 不含源码本身
+  [[nodiscard]] std::size_t
+  memory_bytes() const
+  {
+    return nodes_.size_bytes() + roots_.size_bytes() + numbers_.size_bytes() +
+           strings_.size_bytes() + chars_.size();
+  }
+
+private:
+  void
+  flatten(const Expr &root)
+  {
+    // 显式的栈, 很深的左结合链也不会栈溢出
+    // 第二次出栈时子节点都已经排好, 它们的下标在 done 的栈顶
+    struct Frame
+    {
+      Expr expr;
+      bool expanded;
+    };
+    std::vector<Frame> stack{{root, false}};
+    std::vector<std::uint32_t> done;
+    // 共享的运算节点只排一次, 之后的父节点直接引用它的下标
+    // 每个根节点单独记, 不引用别的根节点那一段里的节点
+    std::unordered_map<const void *, std::uint32_t> memo;
+    while(!stack.empty())
+    {
+      Frame frame = stack.back();
+      stack.pop_back();
+      const void *node = shared_node(frame.expr);
+      if(!frame.expanded)
+      {
+        if(auto it = memo.find(node); node != nullptr && it != memo.end())
+        {
+          done.push_back(it->second);
+          continue;
+        }
+        stack.push_back({frame.expr, true});
+        // 后压入的先处理, 右子节点先压, 左子节点才会排在前面
+        if(auto *const *binary = std::get_if<BinaryExprPtr>(&frame.expr))
+        {
+          stack.push_back({(*binary)->right, false});
+          stack.push_back({(*binary)->left, false});
+        }
+        else if(auto *const *unary = std::get_if<UnaryExprPtr>(&frame.expr))
+        {
+          stack.push_back({(*unary)->expr, false});
+        }
+        else if(auto *const *group = std::get_if<GroupingExprPtr>(&frame.expr))
+        {
+          stack.push_back({(*group)->expr, false});
+        }
+        continue;
+      }
+      done.push_back(emit(frame.expr, done));
+      if(node != nullptr)
+      {
+        memo.emplace(node, done.back());
+      }
+    }
+  }
+
+  // 子节点已经按后序排好, 下标在 done 的栈顶, 用完弹出
+  std::uint32_t
+  emit(const Expr &expr, std::vector<std::uint32_t> &done)
+  {
+    FlatNode node{FlatKind::NIL, 0, 0, 0, kNoOffset};
+    if(auto *const *literal = std::get_if<LiteralExprPtr>(&expr))
+    {
+      emit_literal(**literal, node);
+    }
+    else if(auto *const *binary = std::get_if<BinaryExprPtr>(&expr))
+    {
+      node.kind = FlatKind::BINARY;
+      node.op = static_cast<std::uint8_t>((*binary)->op);
+      node.rhs = pop(done);
+      node.lhs = pop(done);
+      node.offset = offset_of((*binary)->token.get_lexeme());
+    }
+    else if(auto *const *unary = std::get_if<UnaryExprPtr>(&expr))
+    {
+      node.kind = FlatKind::UNARY;
+      node.op = static_cast<std::uint8_t>((*unary)->op);
+      node.lhs = pop(done);
+      node.offset = offset_of((*unary)->token.get_lexeme());
+    }
+    else
+    {
+      node.kind = FlatKind::GROUPING;
+      node.lhs = pop(done);
+    }
+    owned_nodes_.push_back(node);
+    return static_cast<std::uint32_t>(owned_nodes_.size() - 1);
+  }
+
+  void
+  emit_literal(const LiteralExpr &literal, FlatNode &node)
+  {
+    if(const auto *value = std::get_if<double>(&literal.literal))
+    {
+      node.kind = FlatKind::NUMBER;
+      node.lhs = static_cast<std::uint32_t>(owned_numbers_.size());
+      owned_numbers_.push_back(*value);
+    }
+    else if(const auto *value = std::get_if<std::string_view>(&literal.literal))
+    {
+      node.kind = FlatKind::STRING;
+      node.lhs = static_cast<std::uint32_t>(owned_strings_.size());
+      node.rhs = literal.symbol;
+      owned_strings_.push_back(
+          StringRef{static_cast<std::uint32_t>(owned_chars_.size()),
+                    static_cast<std::uint32_t>(value->size())});
+      owned_chars_.insert(owned_chars_.end(), value->begin(), value->end());
+      // 字符串的内容紧跟在前引号后面
+      std::uint32_t at = offset_of(*value);
+      if(at != kNoOffset && at > 0)
+      {
+        node.offset = at - 1;
+      }
+    }
+    else if(const auto *value = std::get_if<bool>(&literal.literal))
+    {
+      node.kind = *value ? FlatKind::TRUE : FlatKind::FALSE;
+    }
+  }
+
+  [[nodiscard]] std::uint32_t
+  offset_of(std::string_view lexeme) const
+  {
+    const char *at = lexeme.data();
+    if(at == nullptr || at < source_.data() ||
+       at > source_.data() + source_.size())
+    {
+      return kNoOffset;
+    }
+    return static_cast<std::uint32_t>(at - source_.data());
+  }
+
+  static std::uint32_t
+  pop(std::vector<std::uint32_t> &done)
+  {
+    std::uint32_t idx = done.back();
+    done.pop_back();
+    return idx;
+  }
+
+  std::span<const FlatNode> nodes_;
+  std::span<const std::uint32_t> roots_;
+  std::span<const double> numbers_;
+  std::span<const StringRef> strings_;
+  std::string_view chars_;
+  std::string_view source_;
+  // from_tree 构建时才用到, view 的时候都是空的
+  std::vector<FlatNode> owned_nodes_;
+  std::vector<std::uint32_t> owned_roots_;
+  std::vector<double> owned_numbers_;
+  std::vector<StringRef> owned_strings_;
+  // 不用 std::string, 短字符串移动时会换地址
+  std::vector<char> owned_chars_;
+};
+} // namespace beacon_lox
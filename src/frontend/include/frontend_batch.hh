@@ -0,0 +1,68 @@
+#pragma once
+
+#include "compilation_unit.hh"
+#include "error.hh"
+#include "work_stealing_pool.hh"
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+
+namespace beacon_lox
+{
+// 并行地读取, 扫描和解析一批文件, 每个文件是线程池里的一个任务
+// 每个 CompilationUnit 有自己的源码, 驻留表, Arena 和诊断列表, 任务之间不共享任何可写的状态
+// 也不经过全局的 g_error: 错误留在各自的 diagnostics() 里, 由调用方用各自的 Error 报告
+// 返回的顺序和 paths 相同, 打不开的文件 is_open() 为 false
+inline std::vector<CompilationUnit>
+parse_files(std::span<const std::string> paths, WorkStealingPool &pool)
+{
+  std::vector<std::optional<CompilationUnit>> slots(paths.size());
+  for(std::size_t i = 0; i < paths.size(); ++i)
+  {
+    pool.submit(
+        [&slot = slots[i], &path = paths[i]]
+        {
+          auto unit = CompilationUnit::open(path);
+          if(unit.is_open())
+          {
+            unit.parse();
+          }
+          slot.emplace(std::move(unit));
+        });
+  }
+  pool.wait();
+
+  std::vector<CompilationUnit> units;
+  units.reserve(paths.size());
+  for(auto &slot : slots)
+  {
+    units.push_back(std::move(*slot));
+  }
+  return units;
+}
+
+// 按 paths 的顺序把所有文件的语法错误格式化到 out 里, 每条前面带上文件名
+// 每个文件用自己的 Error, 返回错误的条数
+inline std::size_t
+report_all(std::span<const std::string> paths,
+           std::span<const CompilationUnit> units,
+           std::vector<std::string> &out)
+{
+  std::size_t count = 0;
+  for(std::size_t i = 0; i < units.size(); ++i)
+  {
+    Error error;
+    units[i].report(error);
+    for(const auto &err : error.errors())
+    {
+      out.push_back(paths[i] + ": " + err);
+      ++count;
+    }
+  }
+  return count;
+}
+} // namespace beacon_lox
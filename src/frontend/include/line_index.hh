@@ -0,0 +1,91 @@
+#pragma once
+
+#include "simd_scan.hh"
+#include "token.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+
+namespace beacon_lox
+{
+// 行号和列号都从 1 开始, 列按字节计算
+// 不在源码里的位置(比如默认构造的 token) 是 {0, 0}
+struct Location
+{
+  unsigned int line;
+  unsigned int column;
+};
+
+// 行首偏移表, 扫描时不再逐个 token 记录行号, 只有报错时才需要
+// 第一次查询时才用 SIMD 找出所有换行建表, 之后每次查询是一次二分
+class LineIndex
+{
+public:
+  explicit LineIndex(std::string_view source)
+    : source_(source)
+  {}
+
+  [[nodiscard]] Location
+  locate(std::size_t offset) const
+  {
+    if(offset > source_.size())
+    {
+      return {0, 0};
+    }
+    build();
+    // 第一个大于 offset 的行首的前一个, 就是 offset 所在的行
+    auto it = std::upper_bound(starts_.begin(),
+                               starts_.end(),
+                               static_cast<std::uint32_t>(offset));
+    auto line = static_cast<unsigned int>(it - starts_.begin());
+    return {line, static_cast<unsigned int>(offset - *(it - 1)) + 1};
+  }
+
+  // token 的位置就是 lexeme 的起点, lexeme 必须指向这份源码
+  [[nodiscard]] Location
+  locate(const Token &token) const
+  {
+    const char *at = token.get_lexeme().data();
+    if(at < source_.data() || at > source_.data() + source_.size())
+    {
+      return {0, 0};
+    }
+    return locate(static_cast<std::size_t>(at - source_.data()));
+  }
+
+  [[nodiscard]] std::size_t
+  line_count() const
+  {
+    build();
+    return starts_.size();
+  }
+
+  [[nodiscard]] std::string_view
+  source() const
+  {
+    return source_;
+  }
+
+private:
+  void
+  build() const
+  {
+    if(!starts_.empty())
+    {
+      return;
+    }
+    starts_.push_back(0);
+    simd::line_starts(source_.data(),
+                      source_.data() + source_.size(),
+                      starts_);
+  }
+
+  std::string_view source_;
+  // 每一行行首的偏移, 第一个总是 0
+  mutable std::vector<std::uint32_t> starts_;
+};
+} // namespace beacon_lox
@@ -0,0 +1,184 @@
+#pragma once
+
+#include "arena.hh"
+#include "ast.hh"
+#include "symbol_table.hh"
+#include "token.hh"
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+
+
+namespace beacon_lox
+{
+// 哈希共享(hash-consing): 结构相同的子树只分配一次, AST 变成一个 DAG
+// 子节点已经是共享的, 所以比较一个节点只需要比较运算符和子节点的地址, 不用递归
+// 字面量按值比较, 字符串有驻留编号时比较编号, 否则比较内容
+// 共享的节点保留第一次出现时的 token, 求值时总是先遇到第一次出现的位置, 报错的位置不变
+// 这只在一条语句之内成立: 一条语句出错后解释器继续求值下一条, 所以运算节点不跨语句共享
+// 每条语句开始时调用 next_scope(), 之后只有字面量(求值不会出错)还和前面的语句共享
+// 被复用过的一元/二元节点会标上 shared, 解释器只缓存这些节点的结果
+class NodeCache
+{
+public:
+  explicit NodeCache(Arena &arena)
+    : arena_(&arena)
+  {}
+
+  Expr
+  literal(const Literal &literal, SymbolId symbol = kNoSymbol)
+  {
+    Key key{LITERAL, static_cast<std::uint8_t>(literal.index()), 0, symbol, {}};
+    if(const auto *number = std::get_if<double>(&literal))
+    {
+      key.a = std::bit_cast<std::uint64_t>(*number);
+    }
+    else if(const auto *boolean = std::get_if<bool>(&literal))
+    {
+      key.a = *boolean ? 1 : 0;
+    }
+    else if(const auto *text = std::get_if<std::string_view>(&literal);
+            text != nullptr && symbol == kNoSymbol)
+    {
+      key.text = *text;
+    }
+    return find_or_make(
+        key,
+        [&] { return arena_->make<LiteralExpr>(literal, symbol); });
+  }
+
+  Expr
+  unary(const Expr &operand, const Token &token, UnaryOp op)
+  {
+    Key key{UNARY,
+            static_cast<std::uint8_t>(op),
+            identity(operand),
+            0,
+            {},
+            scope_};
+    return find_or_make(
+        key,
+        [&] { return arena_->make<UnaryExpr>(operand, token, op); });
+  }
+
+  Expr
+  binary(const Expr &left, const Token &token, BinaryOp op, const Expr &right)
+  {
+    Key key{BINARY,
+            static_cast<std::uint8_t>(op),
+            identity(left),
+            identity(right),
+            {},
+            scope_};
+    return find_or_make(
+        key,
+        [&] { return arena_->make<BinaryExpr>(left, token, op, right); });
+  }
+
+  Expr
+  grouping(const Expr &inner)
+  {
+    Key key{GROUPING, 0, identity(inner), 0, {}, scope_};
+    return find_or_make(key, [&] { return arena_->make<GroupingExpr>(inner); });
+  }
+
+  // 之后创建的运算节点不再和之前的共享, 旧的表项留着, 只是再也查不到
+  void
+  next_scope()
+  {
+    ++scope_;
+  }
+
+  // 复用已有节点的次数, 也就是省下的分配次数
+  [[nodiscard]] std::size_t
+  hits() const
+  {
+    return hits_;
+  }
+
+  [[nodiscard]] std::size_t
+  unique_nodes() const
+  {
+    return nodes_.size();
+  }
+
+private:
+  enum Kind : std::uint8_t
+  {
+    LITERAL,
+    UNARY,
+    BINARY,
+    GROUPING,
+  };
+
+  struct Key
+  {
+    Kind kind;
+    std::uint8_t op;
+    std::uint64_t a;
+    std::uint64_t b;
+    std::string_view text;
+    // 字面量总是 0
+    std::uint32_t scope{0};
+
+    bool
+    operator==(const Key &other) const = default;
+  };
+
+  struct KeyHash
+  {
+    std::size_t
+    operator()(const Key &key) const
+    {
+      std::uint64_t h = (std::uint64_t{key.kind} << 8) | key.op;
+      h = (h ^ key.a) * 0x9e3779b97f4a7c15ULL;
+      h = (h ^ key.b) * 0x9e3779b97f4a7c15ULL;
+      h = (h ^ key.scope) * 0x9e3779b97f4a7c15ULL;
+      if(!key.text.empty())
+      {
+        h ^= SymbolTable::hash(key.text);
+      }
+      return static_cast<std::size_t>(h ^ (h >> 32));
+    }
+  };
+
+  // 节点在 Arena 里, 地址就是它的身份
+  static std::uint64_t
+  identity(const Expr &expr)
+  {
+    return std::visit([](const auto *node)
+                      { return reinterpret_cast<std::uintptr_t>(node); },
+                      expr);
+  }
+
+  template <typename Make>
+  Expr
+  find_or_make(const Key &key, Make make)
+  {
+    auto [it, inserted] = nodes_.try_emplace(key);
+    if(inserted)
+    {
+      it->second = make();
+      return it->second;
+    }
+    ++hits_;
+    if(auto *const *binary = std::get_if<BinaryExprPtr>(&it->second))
+    {
+      (*binary)->shared = true;
+    }
+    else if(auto *const *unary = std::get_if<UnaryExprPtr>(&it->second))
+    {
+      (*unary)->shared = true;
+    }
+    return it->second;
+  }
+
+  Arena *arena_;
+  std::unordered_map<Key, Expr, KeyHash> nodes_;
+  std::size_t hits_{0};
+  std::uint32_t scope_{0};
+};
+} // namespace beacon_lox
@@ -0,0 +1,250 @@
+#pragma once
+
+#include "scanner.hh"
+#include "simd_scan.hh"
+#include "source.hh"
+#include "token.hh"
+#include "utils.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+
+namespace beacon_lox
+{
+// 多线程分段扫描, 结果和 Scanner::scan_tokens() 完全一致
+// 1. 源码在换行之后切段, 段首要么在字符串外, 要么在一个跨行的字符串里
+//    ('//' 注释一定在换行处结束), 每段在自己的线程里按这两种起始状态各扫一遍
+// 2. 从第一段开始按真实状态挑选结果拼接, 跨段的字符串在这里合成一个 token
+// 段在换行之后切开, 一定落在字符边界上, UTF-8 校验也按段并行做
+// token 不带行号, 所以各段的结果不需要再修正
+class ParallelScanner : private Uncopyabble
+{
+public:
+  // 每段至少这么大, 太小的输入直接单线程扫描
+  static constexpr std::size_t kDefaultMinChunk = 256 * 1024;
+
+  // threads 为 0 时使用 hardware_concurrency
+  explicit ParallelScanner(std::string_view source,
+                           unsigned threads = 0,
+                           std::size_t min_chunk = kDefaultMinChunk)
+    : source_(source)
+    , threads_(threads != 0 ? threads : std::thread::hardware_concurrency())
+    , min_chunk_(std::max<std::size_t>(min_chunk, 1))
+  {}
+
+  explicit ParallelScanner(const Source &source, unsigned threads = 0)
+    : ParallelScanner(source.view(), threads)
+  {}
+
+  // 驻留在单线程的拼接阶段进行, 和 Scanner 分配的编号顺序相同
+  void
+  set_symbols(SymbolTable &symbols)
+  {
+    symbols_ = &symbols;
+  }
+
+  std::vector<Token> &
+  scan_tokens()
+  {
+    auto chunks = split();
+
+    std::vector<std::thread> workers;
+    workers.reserve(chunks.size());
+    for(std::size_t i = 1; i < chunks.size(); ++i)
+    {
+      workers.emplace_back([this, &chunk = chunks[i]] { scan_chunk(chunk); });
+    }
+    scan_chunk(chunks[0]);
+    for(auto &worker : workers)
+    {
+      worker.join();
+    }
+
+    stitch(chunks);
+    return tokens_;
+  }
+
+private:
+  static constexpr std::size_t npos = std::string_view::npos;
+
+  // 一种起始状态下的扫描结果
+  struct Speculation
+  {
+    std::vector<Token> tokens;
+    // 从字符串里开始时, 闭合引号的位置
+    std::size_t close{npos};
+    // 段尾还没闭合的字符串的前引号位置
+    std::size_t open{npos};
+    std::string diagnostics;
+  };
+
+  struct Chunk
+  {
+    std::size_t begin{0};
+    std::size_t end{0};
+    // 第一个非法 UTF-8 字节的位置
+    std::size_t invalid{npos};
+    Speculation outside{};
+    Speculation inside{};
+  };
+
+  std::vector<Chunk>
+  split() const
+  {
+    std::vector<Chunk> chunks;
+    const std::size_t size = source_.size();
+    const std::size_t count = std::max<std::size_t>(
+        1,
+        std::min<std::size_t>(threads_, size / min_chunk_));
+
+    std::size_t begin = 0;
+    for(std::size_t i = 1; i < count; ++i)
+    {
+      std::size_t target = i * size / count;
+      if(target <= begin)
+      {
+        continue;
+      }
+      const void *nl =
+          std::memchr(source_.data() + target, '\n', size - target);
+      if(nl == nullptr)
+      {
+        break;
+      }
+      std::size_t cut = static_cast<const char *>(nl) - source_.data() + 1;
+      chunks.push_back(Chunk{begin, cut});
+      begin = cut;
+    }
+    chunks.push_back(Chunk{begin, size});
+    return chunks;
+  }
+
+  void
+  scan_chunk(Chunk &chunk) const
+  {
+    std::size_t valid = simd::validate_utf8(source_.data() + chunk.begin,
+                                            source_.data() + chunk.end);
+    if(chunk.begin + valid != chunk.end)
+    {
+      chunk.invalid = chunk.begin + valid;
+    }
+    scan_from(chunk.begin, chunk.end, chunk.outside);
+    if(chunk.begin == 0)
+    {
+      // 第一段一定从字符串外开始
+      return;
+    }
+
+    // 假设段首在字符串里: 先找闭合的引号, 后面的部分按正常状态扫描
+    std::size_t close =
+        chunk.begin + simd::skip_string(source_.data() + chunk.begin,
+                                        source_.data() + chunk.end);
+    if(close == chunk.end)
+    {
+      // 整段都在字符串里
+      return;
+    }
+    chunk.inside.close = close;
+    scan_from(close + 1, chunk.end, chunk.inside);
+  }
+
+  void
+  scan_from(std::size_t begin, std::size_t end, Speculation &spec) const
+  {
+    std::ostringstream diag;
+    Scanner scanner(source_.substr(begin, end - begin));
+    scanner.set_diagnostics(diag);
+    scanner.skip_utf8_check();
+    for(;;)
+    {
+      Token token = scanner.next_token();
+      if(token.get_type() == TokenType::LOX_EOF)
+      {
+        break;
+      }
+      spec.tokens.push_back(token);
+    }
+    if(scanner.unterminated_string() != npos)
+    {
+      spec.open = begin + scanner.unterminated_string();
+    }
+    spec.diagnostics = diag.str();
+  }
+
+  void
+  stitch(std::vector<Chunk> &chunks)
+  {
+    std::size_t total = 0;
+    for(const auto &chunk : chunks)
+    {
+      total +=
+          std::max(chunk.outside.tokens.size(), chunk.inside.tokens.size());
+    }
+    tokens_.reserve(total + 1);
+
+    // 和 Scanner 一样只报告第一个非法位置
+    for(const auto &chunk : chunks)
+    {
+      if(chunk.invalid != npos)
+      {
+        std::cerr << "invalid utf-8 at byte " << chunk.invalid << "\n";
+        break;
+      }
+    }
+
+    // 正在跨段的字符串的前引号位置
+    std::size_t open = npos;
+    for(auto &chunk : chunks)
+    {
+      Speculation &spec = open == npos ? chunk.outside : chunk.inside;
+      if(open != npos)
+      {
+        if(spec.close == npos)
+        {
+          continue;
+        }
+        auto lexeme = source_.substr(open, spec.close + 1 - open);
+        tokens_.emplace_back(TokenType::STRING,
+                             lexeme,
+                             lexeme.substr(1, lexeme.size() - 2));
+        intern_last();
+      }
+
+      std::cerr << spec.diagnostics;
+      for(const auto &token : spec.tokens)
+      {
+        tokens_.push_back(token);
+        intern_last();
+      }
+      open = spec.open;
+    }
+
+    // 没闭合的字符串和 Scanner 一样直接丢弃
+    tokens_.emplace_back(TokenType::LOX_EOF,
+                         source_.substr(source_.size()),
+                         "null");
+  }
+
+  void
+  intern_last()
+  {
+    if(symbols_ != nullptr)
+    {
+      intern(tokens_.back(), *symbols_);
+    }
+  }
+
+  std::string_view source_;
+  unsigned threads_;
+  std::size_t min_chunk_;
+  std::vector<Token> tokens_;
+  SymbolTable *symbols_{nullptr};
+};
+} // namespace beacon_lox
@@ -1,184 +1,330 @@
 #pragma once
+#include <array>
+#include <cstdint>
+#include <memory>
 #include <vector>
 
 #include "error.hh"
 #include "ast.hh"
+#include "expected.hh"
+#include "node_cache.hh"
 #include "token.hh"
+#include "token_buffer.hh"
+#include "token_stream.hh"
 
 
 namespace beacon_lox
 {
-class Parser
+// parse_all() 的结果: 解析成功的表达式和所有的错误, 节点都在 arena 里
+struct ParseReport
+{
+  Arena arena;
+  std::vector<Expr> exprs;
+  std::vector<Diagnostic> diagnostics;
+};
+
+// Cursor 决定 token 从哪里来, 见 token_stream.hh
+//   Parser                                 整个 token vector
+//   BasicParser<TokenStreamCursor<>>       边扫描边解析, token 内存是常数
+//   BasicParser<TokenBufferCursor>         读取列式存储的 TokenBuffer
+//   BasicParser<TokenSpanCursor>           借用别人的 token 序列, 不拷贝
+template <typename Cursor>
+class BasicParser
 {
 public:
-  Parser(std::vector<Token> token)
-    : tokens_(std::move(token))
+  template <typename... Args>
+  explicit BasicParser(Args &&...args)
+    : cursor_(std::forward<Args>(args)...)
   // , cur_iter_(tokens_.begin())
   // , end_iter_(tokens_.end())
   {}
 
+  // 打开哈希共享: 结构相同的子树只分配一次, 结果是一个 DAG, 见 node_cache.hh
+  // 要在解析之前调用
+  void
+  enable_hash_consing()
+  {
+    cache_ = std::make_unique<NodeCache>(arena_);
+  }
+
+  // 哈希共享时复用已有节点的次数
+  [[nodiscard]] std::size_t
+  shared_nodes() const
+  {
+    return cache_ != nullptr ? cache_->hits() : 0;
+  }
+
+  // 节点都分配在这次解析自己的 Arena 里, 和根节点一起交给调用方
+  // 遇到语法错误时抛出 Error::RuntimeError, 不想要异常的用 try_parse/parse_all
   auto
-  parse() -> Expr
+  parse() -> ParseResult
   {
-    return expression();
+    ExprResult expr = expression();
+    if(!expr)
+    {
+      throw Error::RuntimeError(expr.error().token, expr.error().message);
+    }
+    return ParseResult{std::move(arena_), *expr};
   }
 
-private:
+  // 和 parse() 一样只解析一个表达式, 错误作为返回值, 整条路径上没有异常
   auto
-  expression() -> Expr
+  try_parse() -> Expected<ParseResult, Diagnostic>
   {
-    return equality();
+    ExprResult expr = expression();
+    if(!expr)
+    {
+      return Unexpected{std::move(expr).error()};
+    }
+    return ParseResult{std::move(arena_), *expr};
   }
 
+  // 解析以 ';' 分隔的一串表达式, 直到 EOF, 最后一个可以不带 ';'
+  // 出错时记下错误, 用 synchronize() 跳到下一条语句的开头继续, 一次拿到所有的错误
+  // 哈希共享时运算节点只在一条语句之内共享, 见 NodeCache::next_scope
   auto
-  equality() -> Expr
+  parse_all() -> ParseReport
   {
-    Expr expr = comparsion();
-    while(match(TokenType::BANG_EQUAL, TokenType::EQUAL_EQUAL))
+    ParseReport report;
+    while(!is_at_end())
     {
-      // Token operator = p
-      auto op = previos();
-      Expr right = comparsion();
-      expr = std::make_unique<BinaryExpr>(std::move(expr),
-                                          op,
-                                          static_cast<BinaryOp>(op.get_type()),
-                                          std::move(right));
+      if(cache_ != nullptr)
+      {
+        cache_->next_scope();
+      }
+      ExprResult expr = expression();
+      if(expr && (match(TokenType::SEMICOLON) || is_at_end()))
+      {
+        report.exprs.push_back(*expr);
+        continue;
+      }
+      report.diagnostics.push_back(
+          expr ? Diagnostic{peek(), "Expect ';' after expression."}
+               : std::move(expr).error());
+      synchronize();
     }
+    report.arena = std::move(arena_);
+    return report;
+  }
+
+private:
+  using ExprResult = Expected<Expr, Diagnostic>;
+
+  // Pratt 解析: 每个 token 类型在表里查前缀处理函数和中缀绑定力
+  // 绑定力越大结合得越紧, 0 表示不能作为中缀运算符
+  // 新的运算符只需要在 make_rules() 里加一项
+  using PrefixFn = ExprResult (BasicParser::*)();
+  using InfixFn = ExprResult (BasicParser::*)(Expr left);
+
+  struct Rule
+  {
+    PrefixFn prefix{nullptr};
+    InfixFn infix{nullptr};
+    std::uint8_t power{0};
+  };
+
+  // 和书中的优先级层次对应
+  enum Power : std::uint8_t
+  {
+    NONE,
+    EQUALITY,   // == !=
+    COMPARISON, // > >= < <=
+    TERM,       // + -
+    FACTOR,     // * /
+  };
+
+  static constexpr std::array<Rule, TokenType::LOX_EOF + 1>
+  make_rules()
+  {
+    std::array<Rule, TokenType::LOX_EOF + 1> rules{};
+    rules[TokenType::FALSE] = {&BasicParser::literal, nullptr, NONE};
+    rules[TokenType::TRUE] = {&BasicParser::literal, nullptr, NONE};
+    rules[TokenType::NIL] = {&BasicParser::literal, nullptr, NONE};
+    rules[TokenType::NUMBER] = {&BasicParser::literal, nullptr, NONE};
+    rules[TokenType::STRING] = {&BasicParser::literal, nullptr, NONE};
+    rules[TokenType::LEFT_PAREN] = {&BasicParser::grouping, nullptr, NONE};
+    rules[TokenType::BANS] = {&BasicParser::unary, nullptr, NONE};
+    rules[TokenType::MINUS] = {&BasicParser::unary, &BasicParser::binary, TERM};
+    rules[TokenType::PLUS] = {nullptr, &BasicParser::binary, TERM};
+    rules[TokenType::STAR] = {nullptr, &BasicParser::binary, FACTOR};
+    rules[TokenType::SLASH] = {nullptr, &BasicParser::binary, FACTOR};
+    rules[TokenType::BANG_EQUAL] = {nullptr, &BasicParser::binary, EQUALITY};
+    rules[TokenType::EQUAL_EQUAL] = {nullptr, &BasicParser::binary, EQUALITY};
+    rules[TokenType::GREATER] = {nullptr, &BasicParser::binary, COMPARISON};
+    rules[TokenType::GREATER_EQUAL] = {nullptr,
+                                       &BasicParser::binary,
+                                       COMPARISON};
+    rules[TokenType::LESS] = {nullptr, &BasicParser::binary, COMPARISON};
+    rules[TokenType::LESS_EQUAL] = {nullptr, &BasicParser::binary, COMPARISON};
+    return rules;
+  }
+
+  // 表在编译期生成, 放在函数里是因为类定义完整之后才能取成员函数的地址
+  static const Rule &
+  rule(TokenType type)
+  {
+    static constexpr std::array<Rule, TokenType::LOX_EOF + 1> rules =
+        make_rules();
+    return rules[type];
+  }
 
-    return expr;
+  auto
+  expression() -> ExprResult
+  {
+    return expression(NONE);
   }
 
+  // 只消耗绑定力大于 min_power 的中缀运算符
+  // 右操作数用运算符自己的绑定力解析, 同级的运算符留给外层循环, 所以都是左结合
   auto
-  comparsion() -> Expr
+  expression(std::uint8_t min_power) -> ExprResult
   {
-    Expr exp = term();
-    while(match(TokenType::GREATER,
-                TokenType::GREATER_EQUAL,
-                TokenType::LESS,
-                TokenType::LESS_EQUAL))
+    ExprResult expr = primary();
+    for(;;)
     {
-      auto op = previos();
-      Expr right = term();
-      exp = std::make_unique<BinaryExpr>(std::move(exp),
-                                         op,
-                                         static_cast<BinaryOp>(op.get_type()),
-                                         std::move(right));
+      const Rule &next = rule(cursor_.peek_type());
+      if(!expr || next.infix == nullptr || next.power <= min_power)
+      {
+        return expr;
+      }
+      advance();
+      expr = (this->*next.infix)(*expr);
     }
-    return exp;
   }
 
   auto
-  term() -> Expr
+  binary(Expr left) -> ExprResult
   {
-    Expr exp = factor();
-    while(match(TokenType::PLUS, TokenType::MINUS))
+    auto op = previos();
+    ExprResult right = expression(rule(op.get_type()).power);
+    if(!right)
     {
-      auto op = previos();
-      Expr right = factor();
-      exp = std::make_unique<BinaryExpr>(std::move(exp),
-                                         op,
-                                         static_cast<BinaryOp>(op.get_type()),
-                                         std::move(right));
+      return right;
     }
-    return exp;
+    return make_binary(left, op, static_cast<BinaryOp>(op.get_type()), *right);
   }
 
+  // 和原来的递归下降一样, 一元运算符的操作数只能是 primary
   auto
-  factor() -> Expr
+  unary() -> ExprResult
   {
-    Expr exp = unary();
-    while(match(TokenType::STAR, TokenType::SLASH))
+    auto op = previos();
+    ExprResult expr = operand();
+    if(!expr)
     {
-      auto op = previos();
-      Expr right = unary();
-      exp = std::make_unique<BinaryExpr>(std::move(exp),
-                                         op,
-                                         static_cast<BinaryOp>(op.get_type()),
-                                         std::move(right));
+      return expr;
     }
-    return exp;
+    return make_unary(*expr, op, static_cast<UnaryOp>(op.get_type()));
   }
 
   auto
-  unary() -> Expr
+  literal() -> ExprResult
   {
-    if(match(TokenType::BANS, TokenType::MINUS))
+    auto token = previos();
+    switch(token.get_type())
     {
-      auto op = previos();
-      auto expr = primary();
-      Expr exp =
-          std::make_unique<UnaryExpr>(std::move(expr),
-                                      op,
-                                      static_cast<UnaryOp>(op.get_type()));
-      return exp;
+      case TokenType::FALSE:
+        return make_literal(false);
+      case TokenType::TRUE:
+        return make_literal(true);
+      case TokenType::NUMBER:
+        // 数字的值在这里才真正转换出来
+        return make_literal(token.get_number());
+      case TokenType::STRING:
+        return make_literal(token.get_literal(), token.get_symbol());
+      default:
+        return make_literal(nullptr);
     }
-
-    return primary();
   }
 
   auto
-  primary() -> Expr
+  grouping() -> ExprResult
   {
-    if(match(TokenType::FALSE))
+    ExprResult exp = expression();
+    if(!exp)
     {
-      return std::make_unique<LiteralExpr>(false);
+      return exp;
     }
-    if(match(TokenType::TRUE))
+    if(!check(TokenType::RIGHT_PAREN))
     {
-      return std::make_unique<LiteralExpr>(true);
+      return Unexpected{Diagnostic{peek(), "( not match!"}};
     }
-    if(match(TokenType::NIL))
+    advance();
+    return make_grouping(*exp);
+  }
+
+  // 节点都从这里创建, 打开哈希共享时先在 cache_ 里找
+  auto
+  make_literal(const Literal &literal, SymbolId symbol = kNoSymbol) -> Expr
+  {
+    if(cache_ != nullptr)
     {
-      return std::make_unique<LiteralExpr>(nullptr);
+      return cache_->literal(literal, symbol);
     }
-    if(match(TokenType::NUMBER, TokenType::STRING))
+    return arena_.make<LiteralExpr>(literal, symbol);
+  }
+
+  auto
+  make_unary(const Expr &operand, const Token &token, UnaryOp op) -> Expr
+  {
+    if(cache_ != nullptr)
     {
-      auto token = previos();
-      return std::make_unique<LiteralExpr>(token.get_literal());
+      return cache_->unary(operand, token, op);
     }
+    return arena_.make<UnaryExpr>(operand, token, op);
+  }
 
-    if(match(TokenType::LEFT_PAREN))
+  auto
+  make_binary(const Expr &left,
+              const Token &token,
+              BinaryOp op,
+              const Expr &right) -> Expr
+  {
+    if(cache_ != nullptr)
     {
-      Expr exp = expression();
-      consume(TokenType::RIGHT_PAREN, "( not match!");
-      return std::make_unique<GroupingExpr>(std::move(exp));
+      return cache_->binary(left, token, op, right);
     }
-
-    throw std::runtime_error("Expect expression.");
+    return arena_.make<BinaryExpr>(left, token, op, right);
   }
 
   auto
-  consume(const TokenType &type, std::string_view sv) -> void
+  make_grouping(const Expr &inner) -> Expr
   {
-    if(check(type))
+    if(cache_ != nullptr)
     {
-      advance();
-      return;
+      return cache_->grouping(inner);
     }
-    // std::string str;
-
-    // str += "cur type:";
-    // str += std::to_string(static_cast<int>(tokens_[cur_].get_type()));
-    // str += sv;
-    // throw std::runtime_error(str);
-    g_error.error(error(peek(), sv));
+    return arena_.make<GroupingExpr>(inner);
   }
 
-
+  // 前缀位置: 查表得到处理函数, 没有的就不能开始一个表达式
   auto
-  error(Token token, std::string_view sv) -> Error::RuntimeError
+  primary() -> ExprResult
   {
-    throw Error::RuntimeError(token, std::string(sv));
+    const Rule &next = rule(cursor_.peek_type());
+    if(next.prefix == nullptr)
+    {
+      return Unexpected{Diagnostic{peek(), "Expect expression."}};
+    }
+    advance();
+    return (this->*next.prefix)();
   }
 
-  class ParseError : public std::runtime_error
+  // 一元运算符的操作数: 字面量或者括号, 不能再是一元表达式
+  auto
+  operand() -> ExprResult
   {
-  public:
-    ParseError(const std::string &message = "Parse error occurred")
-      : std::runtime_error(message)
-    {}
-  };
+    const Rule &next = rule(cursor_.peek_type());
+    if(next.prefix == nullptr || next.prefix == &BasicParser::unary)
+    {
+      return Unexpected{Diagnostic{peek(), "Expect expression."}};
+    }
+    advance();
+    return (this->*next.prefix)();
+  }
 
+  // 丢掉出错的 token, 跳到语句的边界: 刚跳过一个 ';', 或者下一个是语句开头的关键字
+  // 出错的 token 至少会被跳过一个, 所以 parse_all() 不会原地打转
   auto
   synchronize() -> void
   {
@@ -190,7 +336,7 @@ private:
         return;
       }
 
-      switch(previos().get_type())
+      switch(cursor_.peek_type())
       {
         case CLASS:
         case FUN:
@@ -256,7 +402,7 @@ private:
     {
       return false; // 空参数包
     }
-    return ((tokens_[cur_].get_type() == args) || ...);
+    return ((cursor_.peek_type() == args) || ...);
   }
 
   template <typename... Args>
@@ -276,27 +422,28 @@ private:
     return false;
   }
 
-  [[nodiscard]] auto
-  peek() -> const Token &
+  // vector/stream 返回引用, TokenBuffer 返回现场还原的 Token
+  [[nodiscard]] decltype(auto)
+  peek()
   {
     // 感觉这里应该还是要加一个处理的
     //   if(cur_iter_ == end_iter_)
     //   {
     //     return
     //   }
-    return tokens_[cur_];
+    return cursor_.peek();
   }
 
-  [[nodiscard]] auto
-  previos() -> const Token &
+  [[nodiscard]] decltype(auto)
+  previos()
   {
-    return tokens_[cur_ - 1];
+    return cursor_.previous();
   }
 
   [[nodiscard]] auto
   is_at_end() const -> bool
   {
-    return tokens_[cur_].get_type() == TokenType::LOX_EOF;
+    return cursor_.peek_type() == TokenType::LOX_EOF;
   }
 
   // 昨天自己有个疑问, 如果超过最后一个字符要怎么处理,这里显示了结果
@@ -308,14 +455,19 @@ private:
     {
       return;
     }
-    ++cur_;
+    cursor_.advance();
   }
 
-  std::vector<Token> tokens_;
   // std::vector<Token>::iterator cur_iter_;
-  int cur_{0};
+  Cursor cursor_;
+  // 本次解析产生的所有节点, parse() 结束时移交给 ParseResult
+  Arena arena_;
+  // 只在打开哈希共享时存在, 引用的是上面的 arena_
+  std::unique_ptr<NodeCache> cache_;
   // 预期: 每个 token 序列的最后一个都是 EOF!
   // 所以这里没有必要单独存储一个 end 了
   // std::vector<Token>::iterator end_iter_;
 };
+
+using Parser = BasicParser<TokenVectorCursor>;
 } // namespace beacon_lox
\ No newline at end of file
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "flat_ast.hh"
+#include "source.hh"
+#include "token.hh"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+
+namespace beacon_lox
+{
+// 缓存文件的布局, 所有的数都按本机字节序, 每一段都按 8 字节对齐
+//   CacheHeader
+//   token 类型(uint8) | token 偏移(uint32) | token 长度(uint32)
+//   FlatNode | 根节点下标(uint32) | 数字(double) | StringRef | 字符串内容
+// 除了头部都是平凡类型的数组, 映射进来之后不做任何转换就能直接使用
+struct CacheSection
+{
+  std::uint64_t offset;
+  std::uint64_t size;
+};
+
+enum CacheSectionId : std::uint32_t
+{
+  TOKEN_TYPES,
+  TOKEN_OFFSETS,
+  TOKEN_LENGTHS,
+  AST_NODES,
+  AST_ROOTS,
+  AST_NUMBERS,
+  AST_STRINGS,
+  AST_CHARS,
+  SECTION_COUNT
+};
+
+struct CacheHeader
+{
+  std::array<char, 8> magic;
+  // 布局有任何变化都要加一, 旧版本的文件会被当作没有命中
+  std::uint32_t version;
+  // 写入时是 0x01020304, 读到别的值说明字节序不同
+  std::uint32_t byte_order;
+  std::uint64_t source_hash;
+  std::uint64_t source_size;
+  std::array<CacheSection, SECTION_COUNT> sections;
+};
+
+
+// 从缓存里映射进来的程序, 不需要再扫描和解析
+// token 和 AST 都直接引用映射的内存, 移动之后仍然有效
+// 字符串节点不带驻留编号(编号只在一个驻留表里有意义), 求值时再驻留
+class CachedProgram
+{
+public:
+  [[nodiscard]] const FlatAst &
+  ast() const
+  {
+    return ast_;
+  }
+
+  [[nodiscard]] std::size_t
+  token_count() const
+  {
+    return types_.size();
+  }
+
+  [[nodiscard]] TokenType
+  token_type(std::size_t idx) const
+  {
+    return static_cast<TokenType>(types_[idx]);
+  }
+
+  [[nodiscard]] std::string_view
+  lexeme(std::size_t idx) const
+  {
+    return source_.substr(offsets_[idx], lengths_[idx]);
+  }
+
+  [[nodiscard]] std::string_view
+  source() const
+  {
+    return source_;
+  }
+
+private:
+  friend class ProgramCache;
+
+  Source file_;
+  std::string_view source_;
+  std::span<const std::uint8_t> types_;
+  std::span<const std::uint32_t> offsets_;
+  std::span<const std::uint32_t> lengths_;
+  FlatAst ast_;
+};
+
+
+// 以源码内容的哈希为键的扫描/解析结果缓存, 每个源码一个文件: <directory>/<hash>.loxc
+// 多个进程可以同时读写同一个目录: 写入先写临时文件再 rename, 读到的一定是完整的文件
+class ProgramCache
+{
+public:
+  static constexpr std::uint32_t kVersion = 1;
+
+  explicit ProgramCache(std::string directory)
+    : directory_(std::move(directory))
+  {}
+
+  // 没有缓存, 或者缓存和源码对不上(哈希, 长度, 版本, 内容损坏) 时返回 nullopt
+  // source 要比返回的 CachedProgram 活得久
+  [[nodiscard]] std::optional<CachedProgram>
+  load(std::string_view source) const;
+
+  // tokens 是 source 扫描出的 token, 以 EOF 结尾, ast 是解析 source 得到的
+  bool
+  store(std::string_view source,
+        std::span<const Token> tokens,
+        const FlatAst &ast) const;
+
+  [[nodiscard]] std::string
+  path_for(std::string_view source) const;
+
+  // MurmurHash64A, 一次处理 8 字节
+  static std::uint64_t
+  hash(std::string_view source);
+
+private:
+  std::string directory_;
+};
+} // namespace beacon_lox
@@ -1,8 +1,14 @@
 #pragma once
 
 #include "token.hh"
+#include "simd_scan.hh"
+#include "source.hh"
+#include "symbol_table.hh"
+#include "unicode.hh"
+#include "utils.hh"
 
 #include <iostream>
+#include <optional>
 #include <vector>
 #include <string>
 #include <string_view>
@@ -10,24 +16,112 @@
 
 namespace beacon_lox
 {
-class Scanner
+// Scanner 内部保存的是 string_view, 自己不能被拷贝或移动
+class Scanner : private Uncopyabble
 {
 public:
   explicit Scanner(std::string contents)
-    : source_(std::move(contents))
+    : owned_(std::move(contents))
+    , source_(owned_)
   {}
 
+  // 直接在 Source 的内存上扫描, 不拷贝源码, token 指向 source 的内存
+  explicit Scanner(const Source &source)
+    : source_(source.view())
+  {}
+
+  // 就地扫描一段已经在内存里的源码, 不拷贝
+  // 并行扫描和增量扫描用它从中间某个位置开始
+  explicit Scanner(std::string_view source)
+    : source_(source)
+  {}
+
+  // 默认输出到 std::cerr, 推测执行的扫描需要先把诊断信息攒起来
+  void
+  set_diagnostics(std::ostream &out)
+  {
+    diag_ = &out;
+  }
+
+  // 设置之后, IDENTIFIER 和 STRING 在扫描时驻留到这个表里
+  void
+  set_symbols(SymbolTable &symbols)
+  {
+    symbols_ = &symbols;
+  }
+
+  [[nodiscard]] SymbolTable *
+  symbols() const
+  {
+    return symbols_;
+  }
+
+  // 调用方已经校验过 UTF-8 (比如并行扫描按段校验), 不用再整体校验一遍
+  void
+  skip_utf8_check()
+  {
+    utf8_checked_ = true;
+  }
+
+  // 扫描到末尾时还没闭合的字符串的起始位置(前引号), 没有则为 npos
+  [[nodiscard]] std::size_t
+  unterminated_string() const
+  {
+    return unterminated_;
+  }
+
   std::vector<Token> &
   scan_tokens()
   {
+    for(;;)
+    {
+      tokens_.push_back(next_token());
+      if(tokens_.back().get_type() == TokenType::LOX_EOF)
+      {
+        break;
+      }
+    }
+    return tokens_;
+  }
+
+  // 扫描完整个源码, 把 token 移交给调用方, 不拷贝
+  // token 的 lexeme 指向源码, 源码要比它们活得久
+  std::vector<Token>
+  take_tokens()
+  {
+    scan_tokens();
+    return std::move(tokens_);
+  }
+
+  [[nodiscard]] std::string_view
+  source() const
+  {
+    return source_;
+  }
+
+  // 拉取式接口: 每次只扫描出下一个 token, 不保存已经产生的 token
+  // 扫描到末尾后一直返回 EOF
+  Token
+  next_token()
+  {
+    if(!utf8_checked_)
+    {
+      check_utf8();
+    }
     while(!is_end())
     {
       start_ = cur_;
       // 进行扫描时，需要先获取一个 char
       scan_token();
+      if(pending_)
+      {
+        Token token = *pending_;
+        pending_.reset();
+        return token;
+      }
     }
-    tokens_.emplace_back(TokenType::LOX_EOF, "", "null", line_);
-    return tokens_;
+    // EOF 的 lexeme 也指向源码末尾, 这样所有 token 都落在同一块内存里
+    return Token{TokenType::LOX_EOF, source_.substr(source_.size()), "null"};
   }
 
 private:
@@ -42,14 +136,18 @@ private:
   {
     // 注意,这里的 cur_, start_ 和自己写时的区别
     // 现在自己猜想,应该是这里创建了局部的 std::string, 导致离开这个函数后,被释放掉了
-    auto lexeme =
-        static_cast<std::string_view>(source_).substr(start_, cur_ - start_);
+    auto lexeme = source_.substr(start_, cur_ - start_);
     // 这里自己一开始想用 get 方法来获取, 但是 get 方法需要的是一个编译期常量, 所以失败了
     // std::cout << "add token lexeme:" << lexeme << ", literal: ";
     // std::visit([](const auto &value) { std::cout << value; }, literal);
     // std::cout << "\n";
 
-    tokens_.emplace_back(type, lexeme, literal, line_);
+    // 一次 scan_token 最多产生一个 token
+    pending_.emplace(type, lexeme, literal);
+    if(symbols_ != nullptr)
+    {
+      intern(*pending_, *symbols_);
+    }
   }
 
   void
@@ -100,20 +198,18 @@ private:
         add_token(match('=') ? TokenType::GREATER_EQUAL : TokenType::GREATER);
         break;
       case '\n':
-        ++line_;
-        break;
       case ' ':
       case '\t':
-      case 'r':
+      case '\r':
+        // 连续的空白一次跳过, 不再每个字符走一遍 switch
+        skip_blank();
         break;
       case '/':
         if(match('/'))
         {
           // while(match('\n'))
-          while(!match('\n') && !is_end())
-          {
-            advance();
-          }
+          // 注释体整段跳过, 换行留给下一轮当作空白处理
+          cur_ += simd::skip_line(cur_ptr(), end_ptr());
         }
         else
         {
@@ -132,9 +228,13 @@ private:
         {
           identifier();
         }
+        else if(!is_ascii(c))
+        {
+          non_ascii();
+        }
         else
         {
-          std::cerr << "unknown char:" << c << "\n";
+          *diag_ << "unknown char:" << c << "\n";
         }
         break;
     }
@@ -143,18 +243,13 @@ private:
   void
   string()
   {
-    while(peek() != '"' && !is_end())
-    {
-      if(peek() == '\n')
-      {
-        ++line_;
-      }
-      advance();
-    }
+    // 找到后引号
+    cur_ += simd::skip_string(cur_ptr(), end_ptr());
 
     if(is_end())
     {
       // lex: error
+      unterminated_ = start_;
       return;
     }
 
@@ -171,31 +266,23 @@ private:
     // std::cout << "add string:"
     // << source_.substr(start_ + 1, cur_ - 1 - (start_ + 1)) << "\n";
     // 同样的问题
-    add_token(
-        TokenType::STRING,
-        static_cast<std::string_view>(source_).substr(start_ + 1,
-                                                      cur_ - 1 - (start_ + 1)));
+    add_token(TokenType::STRING,
+              source_.substr(start_ + 1, cur_ - 1 - (start_ + 1)));
   }
 
   void
   number()
   {
     // 自己最终的想法是先获取整数,然后判断小数是否为0,如果为零,就在最后加个.0, 否则什么都不加
-    while(is_digit(peek()))
-    {
-      advance();
-    }
+    cur_ += simd::skip_digit(cur_ptr(), end_ptr());
     if(peek() == '.' && is_digit(peek_next()))
     {
       advance();
-      while(is_digit(peek()))
-      {
-        advance();
-      }
+      cur_ += simd::skip_digit(cur_ptr(), end_ptr());
     }
     // cur_ 已经代表的是数字结束后的位置了
-    add_token(TokenType::NUMBER,
-              std::stod(source_.substr(start_, cur_ - start_)));
+    // 这里只记录位置, 数值等真正用到时再由 Token::get_number() 转换
+    add_token(TokenType::NUMBER);
     // add_token(TokenType::NUMBER, 2.0);
     // add_token(
     //     TokenType::NUMBER,
@@ -207,15 +294,13 @@ private:
   {
     // 这里自己的第一想法还是要先找string...
     // 调用 string 函数, 实际上并没有什么必要...今天睡觉吧
-    while(is_alpha_digit(peek()))
-    {
-      advance();
-    }
+    // ASCII 部分仍然走 SIMD 内核, 只有遇到非 ASCII 字节才解码
+    cur_ += unicode::skip_identifier(cur_ptr(), end_ptr());
     // !没有考虑到保留字
     // add_token(TokenType::IDENTIFIER, source_.substr(start_, cur_ - start_));
     // auto iden = source_.substr(start_, cur_ - start_);
     // 这里可以节省一次拷贝
-    auto iden = std::string_view(source_).substr(start_, cur_ - start_);
+    auto iden = source_.substr(start_, cur_ - start_);
     TokenType type{TokenType::IDENTIFIER};
     if(iden == "class")
     {
@@ -290,6 +375,41 @@ private:
     add_token(type);
   }
 
+  // 非 ASCII 字符: 能开始标识符的按标识符扫描(一定不是关键字)
+  // 否则连续的一段不认识的字符(包括非法字节)只报一次
+  void
+  non_ascii()
+  {
+    const char *begin = source_.data() + start_;
+    if(std::size_t len = unicode::identifier_start(begin, end_ptr()); len != 0)
+    {
+      cur_ = start_ + len;
+      identifier();
+      return;
+    }
+    cur_ = start_ + unicode::skip_unknown(begin, end_ptr());
+    *diag_ << "unknown char:" << source_.substr(start_, cur_ - start_) << "\n";
+  }
+
+  // 整个源码只校验一次, 只报告第一个非法的位置
+  void
+  check_utf8()
+  {
+    utf8_checked_ = true;
+    std::size_t valid = simd::validate_utf8(source_.data(), end_ptr());
+    if(valid != source_.size())
+    {
+      *diag_ << "invalid utf-8 at byte " << valid << "\n";
+    }
+  }
+
+  // 从 cur_ 开始跳过一整段空白, 换行也只是空白, 行号由 LineIndex 按需计算
+  void
+  skip_blank()
+  {
+    cur_ += simd::skip_blank(cur_ptr(), end_ptr());
+  }
+
   // 当匹配到时, 需要读取
   bool
   match(char c)
@@ -323,6 +443,11 @@ private:
     return c >= '0' && c <= '9';
   }
   static bool
+  is_ascii(char c)
+  {
+    return (static_cast<unsigned char>(c) & 0x80) == 0;
+  }
+  static bool
   is_alpha_digit(char c)
   {
     return is_alpha(c) || is_digit(c);
@@ -349,7 +474,8 @@ private:
   [[nodiscard]] char
   peek_next() const
   {
-    if(cur_ + 1 > source_.size())
+    // source_ 不一定以 '\0' 结尾(比如 mmap 的文件), 不能读到 size() 处
+    if(cur_ + 1 >= source_.size())
     {
       return '\0';
     }
@@ -357,19 +483,36 @@ private:
     return source_[cur_ + 1];
   }
 
+  [[nodiscard]] const char *
+  cur_ptr() const
+  {
+    return source_.data() + cur_;
+  }
+
+  [[nodiscard]] const char *
+  end_ptr() const
+  {
+    return source_.data() + source_.size();
+  }
+
   [[nodiscard]] bool
   is_end() const
   {
     return cur_ >= source_.size();
   }
 
-  std::string source_;
-  unsigned long int line_{1};
+  // 只有用 std::string 构造时才持有源码
+  std::string owned_;
+  std::string_view source_;
   // 存储的是当次扫描开始的位置
   unsigned long int start_{0};
   // 表示的是当前改扫描的位置(实际上还没有扫描)
   unsigned long int cur_{0};
-  std::string_view contents_;
+  std::optional<Token> pending_;
   std::vector<Token> tokens_;
+  std::size_t unterminated_{std::string_view::npos};
+  std::ostream *diag_{&std::cerr};
+  SymbolTable *symbols_{nullptr};
+  bool utf8_checked_{false};
 };
 } // namespace beacon_lox
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Scanner 的批量扫描内核, 实现在 src/scanner.cc
+// 有 AVX2 时一次分类 32 字节, 否则 SSE2 一次 16 字节, 其它平台退化为逐字节扫描
+// skip_* 都返回从 begin 开始满足条件的连续字节数, 不会越过 end
+namespace beacon_lox::simd
+{
+// ' ', '\t', '\r', '\n' 组成的空白段
+std::size_t
+skip_blank(const char *begin, const char *end);
+
+// [A-Za-z0-9_] 组成的标识符剩余部分
+std::size_t
+skip_alpha_digit(const char *begin, const char *end);
+
+// [0-9] 组成的数字段
+std::size_t
+skip_digit(const char *begin, const char *end);
+
+// 注释体: 一直到 '\n'(不包含) 或者 end
+std::size_t
+skip_line(const char *begin, const char *end);
+
+// 字符串体: 一直到 '"'(不包含) 或者 end
+std::size_t
+skip_string(const char *begin, const char *end);
+
+// [begin, end) 中 '\n' 的个数
+std::size_t
+count_newlines(const char *begin, const char *end);
+
+// 把每个 '\n' 之后的偏移(相对 begin, 也就是下一行的行首)追加到 starts
+void
+line_starts(const char *begin,
+            const char *end,
+            std::vector<std::uint32_t> &starts);
+
+// UTF-8 校验, 返回第一个非法字节的偏移, 全部合法时返回 end - begin
+// 整块都是 ASCII 时一次跳过一个向量, 只有非 ASCII 的字符逐个解码
+std::size_t
+validate_utf8(const char *begin, const char *end);
+
+// 当前编译使用的内核名字, 方便测试程序输出
+const char *
+kernel_name();
+} // namespace beacon_lox::simd
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace beacon_lox
+{
+// 源码缓冲区
+// 普通文件直接 mmap, 管道等不能映射的输入退化为读到堆上的缓冲区
+// Scanner 就地扫描, Token 的 lexeme 直接指向这里的内存, 所以 Source 要比 token 和 AST 活得久
+// 移动 Source 不会改变数据的地址, 已经产生的 token 仍然有效
+class Source
+{
+public:
+  Source() = default;
+
+  // 打开失败时 is_open() 返回 false
+  explicit Source(const std::string &path);
+
+  // 已经在内存里的源码, 比如 REPL 的一行输入
+  static Source
+  from_string(std::string_view contents);
+
+  Source(const Source &) = delete;
+  Source &
+  operator=(const Source &) = delete;
+  Source(Source &&other) noexcept;
+  Source &
+  operator=(Source &&other) noexcept;
+  ~Source();
+
+  [[nodiscard]] bool
+  is_open() const
+  {
+    return open_;
+  }
+
+  [[nodiscard]] bool
+  is_mapped() const
+  {
+    return map_ != nullptr;
+  }
+
+  [[nodiscard]] std::string_view
+  view() const
+  {
+    if(map_ != nullptr)
+    {
+      return {static_cast<const char *>(map_), size_};
+    }
+    return {buffer_.data(), buffer_.size()};
+  }
+
+private:
+  void
+  release();
+
+  bool
+  read_fd(int fd);
+
+  void *map_{nullptr};
+  std::size_t size_{0};
+  std::vector<char> buffer_;
+  bool open_{false};
+};
+} // namespace beacon_lox
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "utils.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+
+namespace beacon_lox
+{
+// 符号编号从 0 开始连续分配, 可以直接当数组下标用
+using SymbolId = std::uint32_t;
+inline constexpr SymbolId kNoSymbol = std::numeric_limits<SymbolId>::max();
+
+// 运行时的字符串值, 相等比较就是比较编号
+struct Symbol
+{
+  SymbolId id;
+
+  bool
+  operator==(const Symbol &other) const = default;
+};
+
+// 标识符和字符串的驻留表, 每个不同的字符串只保存一次
+// 字符串的内容拷贝到表自己的内存块里, 不依赖源码, name() 返回的 string_view 一直有效
+// 不是线程安全的, 并行扫描时在单线程的拼接阶段驻留
+class SymbolTable : private Uncopyabble
+{
+public:
+  SymbolTable() = default;
+
+  SymbolId
+  intern(std::string_view name)
+  {
+    const std::uint32_t h = hash(name);
+    if(entries_.size() * 2 >= slots_.size())
+    {
+      grow();
+    }
+    const std::size_t mask = slots_.size() - 1;
+    for(std::size_t slot = h & mask;; slot = (slot + 1) & mask)
+    {
+      SymbolId id = slots_[slot];
+      if(id == kNoSymbol)
+      {
+        id = static_cast<SymbolId>(entries_.size());
+        entries_.push_back(Entry{store(name), h});
+        slots_[slot] = id;
+        return id;
+      }
+      // 先比较哈希, 只有哈希相同时才比较内容
+      if(entries_[id].hash == h && entries_[id].name == name)
+      {
+        return id;
+      }
+    }
+  }
+
+  // 只查找, 不存在时返回 kNoSymbol
+  [[nodiscard]] SymbolId
+  find(std::string_view name) const
+  {
+    if(slots_.empty())
+    {
+      return kNoSymbol;
+    }
+    const std::uint32_t h = hash(name);
+    const std::size_t mask = slots_.size() - 1;
+    for(std::size_t slot = h & mask;; slot = (slot + 1) & mask)
+    {
+      SymbolId id = slots_[slot];
+      if(id == kNoSymbol ||
+         (entries_[id].hash == h && entries_[id].name == name))
+      {
+        return id;
+      }
+    }
+  }
+
+  [[nodiscard]] std::string_view
+  name(SymbolId id) const
+  {
+    return entries_[id].name;
+  }
+
+  // 驻留时算好的哈希, 以后的符号查找表可以直接用
+  [[nodiscard]] std::uint32_t
+  hash_of(SymbolId id) const
+  {
+    return entries_[id].hash;
+  }
+
+  [[nodiscard]] std::size_t
+  size() const
+  {
+    return entries_.size();
+  }
+
+  // FNV-1a
+  static std::uint32_t
+  hash(std::string_view name)
+  {
+    std::uint32_t h = 2166136261U;
+    for(unsigned char c : name)
+    {
+      h ^= c;
+      h *= 16777619U;
+    }
+    return h;
+  }
+
+private:
+  static constexpr std::size_t kBlockSize = 64 * 1024;
+
+  struct Entry
+  {
+    std::string_view name;
+    std::uint32_t hash;
+  };
+
+  void
+  grow()
+  {
+    std::vector<SymbolId> slots(slots_.empty() ? 64 : slots_.size() * 2,
+                                kNoSymbol);
+    const std::size_t mask = slots.size() - 1;
+    for(SymbolId id = 0; id < entries_.size(); ++id)
+    {
+      std::size_t slot = entries_[id].hash & mask;
+      while(slots[slot] != kNoSymbol)
+      {
+        slot = (slot + 1) & mask;
+      }
+      slots[slot] = id;
+    }
+    slots_ = std::move(slots);
+  }
+
+  // 字符串按块分配, 块不会移动, 已经返回的 string_view 不会失效
+  std::string_view
+  store(std::string_view name)
+  {
+    if(blocks_.empty() || used_ + name.size() > kBlockSize)
+    {
+      blocks_.push_back(
+          std::make_unique<char[]>(std::max(kBlockSize, name.size())));
+      used_ = 0;
+    }
+    char *dest = blocks_.back().get() + used_;
+    if(!name.empty())
+    {
+      std::memcpy(dest, name.data(), name.size());
+    }
+    used_ += name.size();
+    return {dest, name.size()};
+  }
+
+  std::vector<Entry> entries_;
+  // 开放寻址, 存的是符号编号, 负载不超过一半
+  std::vector<SymbolId> slots_;
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  std::size_t used_{0};
+};
+} // namespace beacon_lox
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "symbol_table.hh"
+
+#include <charconv>
 #include <format>
 #include <string_view>
 #include <unordered_map>
@@ -62,19 +65,33 @@ enum TokenType
 
 using Literal = std::variant<std::nullptr_t, std::string_view, double, bool>;
 
+// 数字字面量只有 123 和 123.45 两种形式
+// from_chars 不分配内存, 也不受 locale 影响
+inline double
+parse_number(std::string_view digits)
+{
+  double value{0};
+  std::from_chars(digits.data(), digits.data() + digits.size(), value);
+  return value;
+}
+
 
 class Token
 {
 public:
+  // 占位用的空 EOF token
+  Token()
+    : Token(TokenType::LOX_EOF, {}, nullptr)
+  {}
+
   // lexeme n. 词位，词素
+  // token 不记录行号, 位置就是 lexeme 在源码中的地址, 需要时通过 LineIndex 换算
   explicit Token(const TokenType type,
                  const std::string_view lexeme,
-                 const Literal &literal,
-                 const unsigned int line)
+                 const Literal &literal)
     : type_{type}
     , lexeme_{lexeme}
     , literal_{literal}
-    , line_{line}
   {}
 
   [[nodiscard]] TokenType
@@ -89,28 +106,63 @@ public:
     return lexeme_;
   }
 
+  // NUMBER 的值不在扫描时转换, 而是每次从 lexeme 现场解析
   [[nodiscard]] Literal
   get_literal() const
   {
+    if(type_ == TokenType::NUMBER)
+    {
+      return get_number();
+    }
     return literal_;
   }
 
-  [[nodiscard]] unsigned int
-  get_line() const
+  [[nodiscard]] double
+  get_number() const
   {
-    return line_;
+    return parse_number(lexeme_);
+  }
+
+  // IDENTIFIER 和 STRING 的驻留编号, 其它 token 是 kNoSymbol
+  // 比较两个名字或者字符串是否相同时只比较编号
+  [[nodiscard]] SymbolId
+  get_symbol() const
+  {
+    return symbol_;
+  }
+
+  void
+  set_symbol(SymbolId symbol)
+  {
+    symbol_ = symbol;
   }
 
 private:
   TokenType type_;
+  // 正好放在 type_ 后面的对齐空隙里, Token 的大小不变
+  SymbolId symbol_{kNoSymbol};
   // 形式区分,  lexis: 词语,单词 -eme: 表示最小单位
   // 最小语义单元的原始字符串表示, 就是 token
   std::string_view lexeme_;
   // 语义, 就是值
   Literal literal_;
-  unsigned int line_;
 };
 
+// 标识符按名字驻留, 字符串按去掉引号后的内容驻留
+inline void
+intern(Token &token, SymbolTable &symbols)
+{
+  if(token.get_type() == TokenType::IDENTIFIER)
+  {
+    token.set_symbol(symbols.intern(token.get_lexeme()));
+  }
+  else if(token.get_type() == TokenType::STRING)
+  {
+    auto lexeme = token.get_lexeme();
+    token.set_symbol(symbols.intern(lexeme.substr(1, lexeme.size() - 2)));
+  }
+}
+
 } // namespace beacon_lox
 
 // 自定义格式化器
@@ -210,7 +262,7 @@ struct std::formatter<beacon_lox::Token>
 using beacon_lox::TokenType;
 
 // 完整的映射表
-const std::unordered_map<TokenType, std::string> token_type_2_string = {
+inline const std::unordered_map<TokenType, std::string> token_type_2_string = {
     {TokenType::LEFT_PAREN, "LEFT_PAREN"},
     {TokenType::RIGHT_PAREN, "RIGHT_PAREN"},
     {TokenType::LEFT_BRACE, "LEFT_BRACE"},
@@ -251,6 +303,15 @@ const std::unordered_map<TokenType, std::string> token_type_2_string = {
     {TokenType::WHILE, "WHILE"},
     {TokenType::LOX_EOF, "EOF"}};
 
+// 不拷贝字符串, 返回的 string_view 指向上面的表
+inline std::string_view
+token_type_name(TokenType type)
+{
+  auto it = token_type_2_string.find(type);
+  return it == token_type_2_string.end() ? std::string_view{"Unkonwn"}
+                                         : std::string_view{it->second};
+}
+
 // 这里已经忘记了怎么实现自定义 format 了.
 template <>
 class std::formatter<TokenType>
@@ -267,9 +328,6 @@ public:
   auto
   format(const TokenType &value, FormatContext &context) const
   {
-    auto it = token_type_2_string.find(value);
-    std::string str =
-        (it == token_type_2_string.end()) ? "Unkonwn" : it->second;
-    return std::format_to(context.out(), "{}", str);
+    return std::format_to(context.out(), "{}", token_type_name(value));
   }
 };
\ No newline at end of file
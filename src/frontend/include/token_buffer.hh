@@ -0,0 +1,402 @@
+#pragma once
+
+#include "scanner.hh"
+#include "simd_scan.hh"
+#include "token.hh"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+
+namespace beacon_lox
+{
+// 列式(structure-of-arrays) 存储的 token 序列
+// 每个 token 只占 1 字节类型 + 4 字节偏移 + 4 字节长度 + 4 字节符号
+// 行号不存, 需要时用 LineIndex 从偏移换算
+// 字面量都从 lexeme 得到: NUMBER 用到时再转换, STRING 去掉两边的引号
+// lexeme 通过偏移从源码中取出, 所以 TokenBuffer 不能比源码活得久
+//
+// 每一列都是一个 gap buffer: 物理上 [gap_begin_, gap_end_) 是空隙, 空隙停在上次修改的位置
+// 空隙后面的 token 的偏移还要加上 shift_offset_, 修改引起的平移只改这一个数
+class TokenBuffer
+{
+public:
+  // 源码中的一次修改: 从 offset 开始删掉 removed 个字节, 再插入 inserted 个字节
+  struct Edit
+  {
+    std::uint32_t offset;
+    std::uint32_t removed;
+    std::uint32_t inserted;
+  };
+
+  explicit TokenBuffer(std::string_view source)
+    : source_(source)
+  {
+    // 偏移和长度都是 32 位的
+    assert(source.size() <= std::numeric_limits<std::uint32_t>::max());
+  }
+
+  // 用 Scanner 的拉取接口直接填充, 中间不会生成 std::vector<Token>
+  static TokenBuffer
+  scan(Scanner &scanner)
+  {
+    TokenBuffer buffer(scanner.source());
+    buffer.symbols_ = scanner.symbols();
+    for(;;)
+    {
+      Token token = scanner.next_token();
+      buffer.push_back(token);
+      if(token.get_type() == TokenType::LOX_EOF)
+      {
+        break;
+      }
+    }
+    buffer.shrink_to_fit();
+    return buffer;
+  }
+
+  // 只用于构建, 要求空隙为空并且在末尾
+  void
+  push_back(const Token &token)
+  {
+    assert(gap_begin_ == gap_end_ && gap_end_ == types_.size());
+    auto lexeme = token.get_lexeme();
+    types_.push_back(static_cast<std::uint8_t>(token.get_type()));
+    offsets_.push_back(
+        static_cast<std::uint32_t>(lexeme.data() - source_.data()));
+    lengths_.push_back(static_cast<std::uint32_t>(lexeme.size()));
+    symbol_ids_.push_back(token.get_symbol());
+    gap_begin_ = gap_end_ = types_.size();
+  }
+
+  // 增量扫描: source 是修改之后的完整源码, edit 描述这次修改
+  // 1. 从修改点之前最后一个不受影响的 token 的末尾开始重新扫描
+  //    Scanner 最多向后看 2 个字符('1.' 后面是不是数字), 所以要求 token 末尾 + 2 <= offset
+  // 2. 新 token 落在插入的文本之后, 并且和某个旧 token 的起点(平移后)重合时,
+  //    两边的扫描状态完全相同, 之后的 token 只是整体平移, 扫描到这里就停下
+  // 3. 把空隙移到修改点, 旧 token 并入空隙, 新 token 从空隙里分配
+  //    后面 token 的偏移不逐个修改, 而是记在 shift_offset_ 里, 访问时再加上
+  // 返回重新扫描出的 token 数, 耗时和修改的范围以及和上次修改的距离(空隙移动的 token 数)相关,
+  // 和文件大小无关; 只有空隙不够用时才重新分配, 空隙按当前大小的一半扩大, 均摊下来是常数
+  std::size_t
+  apply_edit(std::string_view source, const Edit &edit)
+  {
+    assert(source.size() <= std::numeric_limits<std::uint32_t>::max());
+    // 都按 32 位无符号数回绕计算, 删除比插入多时也是对的
+    const std::uint32_t delta = edit.inserted - edit.removed;
+
+    // 二分找保留的 token 数, 最后一个是 EOF, 它的位置一定受影响
+    assert(size() > 0);
+    std::size_t keep = 0;
+    std::size_t count = size() - 1;
+    while(count > 0)
+    {
+      std::size_t half = count / 2;
+      std::size_t idx = keep + half;
+      if(std::uint64_t{offset(idx)} + length(idx) + 2 <= edit.offset)
+      {
+        keep = idx + 1;
+        count -= half + 1;
+      }
+      else
+      {
+        count = half;
+      }
+    }
+    const std::uint32_t start =
+        keep == 0 ? 0 : offset(keep - 1) + length(keep - 1);
+
+    Scanner scanner(source.substr(start));
+    // 只校验重新扫描的这一段, 见下面
+    scanner.skip_utf8_check();
+    if(symbols_ != nullptr)
+    {
+      scanner.set_symbols(*symbols_);
+    }
+    std::vector<Token> fresh;
+    std::size_t old = keep;
+    for(;;)
+    {
+      Token token = scanner.next_token();
+      auto at = static_cast<std::uint32_t>(token.get_lexeme().data() -
+                                           source.data());
+      if(at >= std::uint64_t{edit.offset} + edit.inserted)
+      {
+        const std::uint32_t old_at = at - delta;
+        while(old < size() && offset(old) < old_at)
+        {
+          ++old;
+        }
+        if(old < size() && offset(old) == old_at)
+        {
+          break;
+        }
+      }
+      fresh.push_back(token);
+      if(token.get_type() == TokenType::LOX_EOF)
+      {
+        // 旧的 EOF 一定能对上, 这里只是兜底
+        old = size();
+        break;
+      }
+    }
+
+    // 重新扫描过的范围就是 [start, 最后一个新 token 之后), 只有这里可能有新的非法字节
+    const char *checked = source.data() + start;
+    const char *checked_end =
+        source.data() + (old < size() ? offset(old) + delta : source.size());
+    std::size_t valid = simd::validate_utf8(checked, checked_end);
+    if(checked + valid != checked_end)
+    {
+      std::cerr << "invalid utf-8 at byte " << start + valid << "\n";
+    }
+
+    splice(keep, old, fresh, source);
+    shift_offset_ += delta;
+    source_ = source;
+    return fresh.size();
+  }
+
+  // 同时去掉空隙
+  void
+  shrink_to_fit()
+  {
+    move_gap(size());
+    for_each_column([this](auto &column) { column.resize(gap_begin_); });
+    gap_end_ = gap_begin_;
+    types_.shrink_to_fit();
+    offsets_.shrink_to_fit();
+    lengths_.shrink_to_fit();
+    symbol_ids_.shrink_to_fit();
+  }
+
+  [[nodiscard]] std::size_t
+  size() const
+  {
+    return types_.size() - (gap_end_ - gap_begin_);
+  }
+
+  [[nodiscard]] TokenType
+  type(std::size_t idx) const
+  {
+    return static_cast<TokenType>(types_[physical(idx)]);
+  }
+
+  [[nodiscard]] std::uint32_t
+  offset(std::size_t idx) const
+  {
+    if(idx < gap_begin_)
+    {
+      return offsets_[idx];
+    }
+    return offsets_[physical(idx)] + shift_offset_;
+  }
+
+  [[nodiscard]] std::uint32_t
+  length(std::size_t idx) const
+  {
+    return lengths_[physical(idx)];
+  }
+
+  [[nodiscard]] SymbolId
+  symbol(std::size_t idx) const
+  {
+    return symbol_ids_[physical(idx)];
+  }
+
+  [[nodiscard]] std::string_view
+  lexeme(std::size_t idx) const
+  {
+    return source_.substr(offset(idx), length(idx));
+  }
+
+  [[nodiscard]] Literal
+  literal(std::size_t idx) const
+  {
+    switch(type(idx))
+    {
+      case TokenType::NUMBER:
+        return parse_number(lexeme(idx));
+      case TokenType::STRING:
+        return lexeme(idx).substr(1, length(idx) - 2);
+      default:
+        return nullptr;
+    }
+  }
+
+  // 还原成一个完整的 Token
+  [[nodiscard]] Token
+  token(std::size_t idx) const
+  {
+    Token token{type(idx), lexeme(idx), literal(idx)};
+    token.set_symbol(symbol(idx));
+    return token;
+  }
+
+  [[nodiscard]] std::string_view
+  source() const
+  {
+    return source_;
+  }
+
+  // 实际占用的字节数, 不含源码本身
+  [[nodiscard]] std::size_t
+  memory_bytes() const
+  {
+    return types_.capacity() * sizeof(std::uint8_t) +
+           offsets_.capacity() * sizeof(std::uint32_t) +
+           lengths_.capacity() * sizeof(std::uint32_t) +
+           symbol_ids_.capacity() * sizeof(SymbolId);
+  }
+
+private:
+  // 逻辑下标换算成物理下标, 跳过空隙
+  [[nodiscard]] std::size_t
+  physical(std::size_t idx) const
+  {
+    return idx < gap_begin_ ? idx : idx + (gap_end_ - gap_begin_);
+  }
+
+  template <typename F>
+  void
+  for_each_column(F f)
+  {
+    f(types_);
+    f(offsets_);
+    f(lengths_);
+    f(symbol_ids_);
+  }
+
+  // 把空隙移到逻辑下标 at 之前, 只搬动两者之间的 token
+  // 越过空隙的 token 在延迟平移的两侧之间换边, 偏移相应地加上或者减去 shift_offset_
+  void
+  move_gap(std::size_t at)
+  {
+    if(at < gap_begin_)
+    {
+      const std::size_t count = gap_begin_ - at;
+      for_each_column(
+          [this, at](auto &column)
+          {
+            std::move_backward(column.begin() + at,
+                               column.begin() + gap_begin_,
+                               column.begin() + gap_end_);
+          });
+      gap_begin_ -= count;
+      gap_end_ -= count;
+      for(std::size_t i = gap_end_; i < gap_end_ + count; ++i)
+      {
+        offsets_[i] -= shift_offset_;
+      }
+    }
+    else if(at > gap_begin_)
+    {
+      const std::size_t count = at - gap_begin_;
+      for(std::size_t i = gap_end_; i < gap_end_ + count; ++i)
+      {
+        offsets_[i] += shift_offset_;
+      }
+      for_each_column(
+          [this, count](auto &column)
+          {
+            std::move(column.begin() + gap_end_,
+                      column.begin() + gap_end_ + count,
+                      column.begin() + gap_begin_);
+          });
+      gap_begin_ += count;
+      gap_end_ += count;
+    }
+  }
+
+  // 修改之后 [keep, old) 被新 token 替换, [old, size) 留在空隙后面, 由调用方加上平移
+  void
+  splice(std::size_t keep,
+         std::size_t old,
+         const std::vector<Token> &fresh,
+         std::string_view source)
+  {
+    move_gap(old);
+    gap_begin_ = keep;
+    const std::size_t count = fresh.size();
+    if(gap_end_ - gap_begin_ < count)
+    {
+      const std::size_t grow = std::max(count, size() / 2 + 64);
+      for_each_column(
+          [this, grow](auto &column)
+          {
+            using T = typename std::decay_t<decltype(column)>::value_type;
+            column.insert(column.begin() + gap_end_, grow, T{});
+          });
+      gap_end_ += grow;
+    }
+    for(const auto &token : fresh)
+    {
+      auto lexeme = token.get_lexeme();
+      types_[gap_begin_] = static_cast<std::uint8_t>(token.get_type());
+      offsets_[gap_begin_] =
+          static_cast<std::uint32_t>(lexeme.data() - source.data());
+      lengths_[gap_begin_] = static_cast<std::uint32_t>(lexeme.size());
+      symbol_ids_[gap_begin_] = token.get_symbol();
+      ++gap_begin_;
+    }
+  }
+
+  std::string_view source_;
+  std::vector<std::uint8_t> types_;
+  std::vector<std::uint32_t> offsets_;
+  std::vector<std::uint32_t> lengths_;
+  std::vector<SymbolId> symbol_ids_;
+  // 构建时用的驻留表, 增量扫描继续用它
+  SymbolTable *symbols_{nullptr};
+  // 空隙的物理范围, 构建时空隙为空并且在末尾
+  std::size_t gap_begin_{0};
+  std::size_t gap_end_{0};
+  // 空隙后面的 token 还要加上这个平移量(按 32 位回绕)
+  std::uint32_t shift_offset_{0};
+};
+
+
+// Parser 直接读取 TokenBuffer, check/match 只访问 1 字节的类型数组
+class TokenBufferCursor
+{
+public:
+  explicit TokenBufferCursor(const TokenBuffer &buffer)
+    : buffer_(&buffer)
+  {}
+
+  [[nodiscard]] TokenType
+  peek_type() const
+  {
+    return buffer_->type(cur_);
+  }
+
+  [[nodiscard]] Token
+  peek() const
+  {
+    return buffer_->token(cur_);
+  }
+
+  [[nodiscard]] Token
+  previous() const
+  {
+    return buffer_->token(cur_ - 1);
+  }
+
+  void
+  advance()
+  {
+    ++cur_;
+  }
+
+private:
+  const TokenBuffer *buffer_;
+  std::size_t cur_{0};
+};
+} // namespace beacon_lox
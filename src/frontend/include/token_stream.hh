@@ -0,0 +1,250 @@
+#pragma once
+
+#include "scanner.hh"
+#include "token.hh"
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <span>
+#include <vector>
+
+
+namespace beacon_lox
+{
+// 把 Scanner 包装成一个只读一遍的 token 序列, 最后一个元素是 EOF
+//   for(const auto &token : TokenStream{scanner}) { ... }
+class TokenStream
+{
+public:
+  class iterator
+  {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = Token;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Token *;
+    using reference = const Token &;
+
+    iterator() = default;
+    explicit iterator(Scanner *scanner)
+      : scanner_(scanner)
+      , token_(scanner->next_token())
+    {}
+
+    reference
+    operator*() const
+    {
+      return token_;
+    }
+    pointer
+    operator->() const
+    {
+      return &token_;
+    }
+
+    iterator &
+    operator++()
+    {
+      if(token_.get_type() == TokenType::LOX_EOF)
+      {
+        scanner_ = nullptr;
+      }
+      else
+      {
+        token_ = scanner_->next_token();
+      }
+      return *this;
+    }
+    void
+    operator++(int)
+    {
+      ++*this;
+    }
+
+    bool
+    operator==(const iterator &other) const
+    {
+      return scanner_ == other.scanner_;
+    }
+
+  private:
+    Scanner *scanner_{nullptr};
+    Token token_;
+  };
+
+  explicit TokenStream(Scanner &scanner)
+    : scanner_(&scanner)
+  {}
+
+  iterator
+  begin()
+  {
+    return iterator{scanner_};
+  }
+  iterator
+  end()
+  {
+    return {};
+  }
+
+private:
+  Scanner *scanner_;
+};
+
+
+// Parser 通过 cursor 读取 token, 需要的接口:
+//   peek_type() 当前 token 的类型, check/match 只用这个
+//   peek()     当前 token
+//   previous() 上一个已经消耗的 token
+//   advance()  前进一个, 调用方保证当前不是 EOF
+
+// 整个 token 序列都在内存里
+class TokenVectorCursor
+{
+public:
+  explicit TokenVectorCursor(std::vector<Token> tokens)
+    : tokens_(std::move(tokens))
+  {}
+
+  [[nodiscard]] TokenType
+  peek_type() const
+  {
+    return tokens_[cur_].get_type();
+  }
+
+  [[nodiscard]] const Token &
+  peek() const
+  {
+    return tokens_[cur_];
+  }
+
+  [[nodiscard]] const Token &
+  previous() const
+  {
+    return tokens_[cur_ - 1];
+  }
+
+  void
+  advance()
+  {
+    ++cur_;
+  }
+
+private:
+  std::vector<Token> tokens_;
+  std::size_t cur_{0};
+};
+
+// 只借用别人的 token 序列, 不拷贝也不拥有, 比如 CompilationUnit 里的 token
+// 序列必须以 EOF 结尾, 并且比 cursor 活得久
+class TokenSpanCursor
+{
+public:
+  explicit TokenSpanCursor(std::span<const Token> tokens)
+    : tokens_(tokens)
+  {}
+
+  [[nodiscard]] TokenType
+  peek_type() const
+  {
+    return tokens_[cur_].get_type();
+  }
+
+  [[nodiscard]] const Token &
+  peek() const
+  {
+    return tokens_[cur_];
+  }
+
+  [[nodiscard]] const Token &
+  previous() const
+  {
+    return tokens_[cur_ - 1];
+  }
+
+  void
+  advance()
+  {
+    ++cur_;
+  }
+
+private:
+  std::span<const Token> tokens_;
+  std::size_t cur_{0};
+};
+
+// 从 Scanner 按需拉取 token, 只在一个固定大小的环形缓冲区里保留
+// 上一个 token, 当前 token 以及最多 Capacity - 2 个预读的 token
+// 不管输入多大, token 占用的内存都是常数
+template <std::size_t Capacity = 4>
+class TokenStreamCursor
+{
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two and at least 2");
+
+public:
+  explicit TokenStreamCursor(Scanner &scanner)
+    : scanner_(&scanner)
+  {
+    fill();
+  }
+
+  // 向前看 ahead 个 token, 0 就是当前 token, 最多看 Capacity - 2 个
+  [[nodiscard]] const Token &
+  peek_ahead(std::size_t ahead)
+  {
+    assert(ahead + 2 <= Capacity);
+    while(filled_ <= cur_ + ahead)
+    {
+      fill();
+    }
+    return ring_[(cur_ + ahead) & kMask];
+  }
+
+  [[nodiscard]] TokenType
+  peek_type() const
+  {
+    return ring_[cur_ & kMask].get_type();
+  }
+
+  [[nodiscard]] const Token &
+  peek() const
+  {
+    return ring_[cur_ & kMask];
+  }
+
+  [[nodiscard]] const Token &
+  previous() const
+  {
+    return ring_[(cur_ - 1) & kMask];
+  }
+
+  void
+  advance()
+  {
+    ++cur_;
+    if(filled_ == cur_)
+    {
+      fill();
+    }
+  }
+
+private:
+  static constexpr std::size_t kMask = Capacity - 1;
+
+  void
+  fill()
+  {
+    ring_[filled_ & kMask] = scanner_->next_token();
+    ++filled_;
+  }
+
+  Scanner *scanner_;
+  std::array<Token, Capacity> ring_{};
+  // 都是单调递增的逻辑下标, 取模后才是环形缓冲区里的位置
+  std::size_t cur_{0};
+  std::size_t filled_{0};
+};
+} // namespace beacon_lox
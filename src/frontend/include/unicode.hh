@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+
+
+// Scanner 的 Unicode 慢路径, 实现在 src/unicode.cc
+// 只有遇到非 ASCII 字节时才会调用, ASCII 仍然走 simd_scan.hh 里的内核
+namespace beacon_lox::unicode
+{
+// 解码 begin 处的一个 UTF-8 字符, 返回字节数, 非法序列返回 0
+// 过长编码, 代理区(U+D800-U+DFFF) 和超过 U+10FFFF 的都算非法
+std::size_t
+decode(const char *begin, const char *end, char32_t &cp);
+
+// UAX #31 的标识符字符, 只查非 ASCII 部分的区间表
+bool
+is_xid_start(char32_t cp);
+
+bool
+is_xid_continue(char32_t cp);
+
+// begin 处是否是一个可以开始标识符的非 ASCII 字符, 是则返回它的字节数, 否则返回 0
+std::size_t
+identifier_start(const char *begin, const char *end);
+
+// 标识符剩余部分: [A-Za-z0-9_] 和 XID_Continue
+std::size_t
+skip_identifier(const char *begin, const char *end);
+
+// 连续的不能开始标识符的非 ASCII 字符(包括非法字节), 一起只报一次错
+std::size_t
+skip_unknown(const char *begin, const char *end);
+} // namespace beacon_lox::unicode
@@ -0,0 +1,204 @@
+#pragma once
+
+#include "utils.hh"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace beacon_lox
+{
+// 每个线程一个任务队列的线程池
+// 自己从队尾取(后提交的先做, 数据还在缓存里), 自己的做完了就从别人的队首偷(最早提交的, 通常也是最大的一块)
+// 文件大小差别很大时, 先做完的线程会去分担还没开始的文件, 不会出现一个线程拖到最后
+// 队列用互斥锁保护: 任务是整个文件的扫描和解析, 锁的开销可以忽略
+class WorkStealingPool : private Uncopyabble
+{
+public:
+  using Task = std::function<void()>;
+
+  // threads 为 0 时使用 hardware_concurrency
+  explicit WorkStealingPool(unsigned threads = 0)
+  {
+    unsigned count =
+        threads != 0 ? threads : std::thread::hardware_concurrency();
+    count = count != 0 ? count : 1;
+    for(unsigned i = 0; i < count; ++i)
+    {
+      queues_.push_back(std::make_unique<Queue>());
+    }
+    workers_.reserve(count);
+    for(unsigned i = 0; i < count; ++i)
+    {
+      workers_.emplace_back([this, i] { run(i); });
+    }
+  }
+
+  ~WorkStealingPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for(auto &worker : workers_)
+    {
+      worker.join();
+    }
+  }
+
+  // 在工作线程里提交的任务放进这个线程自己的队列, 否则轮流放进各个队列
+  void
+  submit(Task task)
+  {
+    pending_.fetch_add(1, std::memory_order_relaxed);
+    unsigned idx = current_pool() == this
+                       ? current_index()
+                       : next_.fetch_add(1, std::memory_order_relaxed) %
+                             queues_.size();
+    {
+      std::lock_guard<std::mutex> lock(queues_[idx]->mutex);
+      queues_[idx]->tasks.push_back(std::move(task));
+    }
+    {
+      // 在 mutex_ 里增加计数, 正准备睡眠的线程不会错过这次唤醒
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++queued_;
+    }
+    wake_.notify_one();
+  }
+
+  // 等待所有已经提交的任务完成
+  void
+  wait()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock,
+               [this]
+               { return pending_.load(std::memory_order_acquire) == 0; });
+  }
+
+  [[nodiscard]] unsigned
+  size() const
+  {
+    return static_cast<unsigned>(workers_.size());
+  }
+
+  // 从别的线程的队列里偷到的任务数
+  [[nodiscard]] std::size_t
+  steals() const
+  {
+    return steals_.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct Queue
+  {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  static WorkStealingPool *&
+  current_pool()
+  {
+    static thread_local WorkStealingPool *pool = nullptr;
+    return pool;
+  }
+
+  static unsigned &
+  current_index()
+  {
+    static thread_local unsigned index = 0;
+    return index;
+  }
+
+  void
+  run(unsigned self)
+  {
+    current_pool() = this;
+    current_index() = self;
+    for(;;)
+    {
+      Task task;
+      if(pop(self, task) || steal(self, task))
+      {
+        task();
+        if(pending_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          idle_.notify_all();
+        }
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this] { return stop_ || queued_ > 0; });
+      if(stop_ && queued_ <= 0)
+      {
+        return;
+      }
+    }
+  }
+
+  bool
+  pop(unsigned self, Task &task)
+  {
+    Queue &queue = *queues_[self];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if(queue.tasks.empty())
+    {
+      return false;
+    }
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    taken();
+    return true;
+  }
+
+  bool
+  steal(unsigned self, Task &task)
+  {
+    for(std::size_t i = 1; i < queues_.size(); ++i)
+    {
+      Queue &queue = *queues_[(self + i) % queues_.size()];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if(queue.tasks.empty())
+      {
+        continue;
+      }
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+      taken();
+      steals_.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+    return false;
+  }
+
+  void
+  taken()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --queued_;
+  }
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable idle_;
+  // 还在队列里的任务数, 只在 mutex_ 里读写
+  long queued_{0};
+  bool stop_{false};
+  // 已经提交但还没完成的任务数
+  std::atomic<std::size_t> pending_{0};
+  std::atomic<unsigned> next_{0};
+  std::atomic<std::size_t> steals_{0};
+};
+} // namespace beacon_lox
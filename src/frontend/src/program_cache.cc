@@ -0,0 +1,325 @@
+#include "program_cache.hh"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <type_traits>
+#include <vector>
+
+namespace beacon_lox
+{
+namespace
+{
+constexpr std::array<char, 8> kMagic{'B', 'L', 'O', 'X', 'A', 'S', 'T', '\0'};
+constexpr std::uint32_t kByteOrder = 0x01020304;
+
+static_assert(std::is_trivially_copyable_v<CacheHeader>);
+static_assert(std::is_trivially_copyable_v<FlatNode>);
+static_assert(std::is_trivially_copyable_v<FlatAst::StringRef>);
+
+// 追加一段数据, 段首按 8 字节对齐
+template <typename T>
+CacheSection
+append(std::vector<char> &image, std::span<const T> data)
+{
+  image.resize((image.size() + 7) & ~std::size_t{7});
+  CacheSection section{image.size(), data.size_bytes()};
+  const char *bytes = reinterpret_cast<const char *>(data.data());
+  image.insert(image.end(), bytes, bytes + data.size_bytes());
+  return section;
+}
+
+// 取出一段数据的视图, 越界, 没对齐或者大小不是整数个元素时返回 false
+template <typename T>
+bool
+section_view(std::string_view file,
+             const CacheSection &section,
+             std::span<const T> &out)
+{
+  if(section.offset > file.size() ||
+     section.size > file.size() - section.offset ||
+     section.offset % alignof(T) != 0 || section.size % sizeof(T) != 0)
+  {
+    return false;
+  }
+  out = {reinterpret_cast<const T *>(file.data() + section.offset),
+         section.size / sizeof(T)};
+  return true;
+}
+
+// 映射进来的数据不可信, 每个下标都要检查, 保证求值时不会越界
+bool
+validate(const FlatAst &ast, std::size_t source_size)
+{
+  const auto nodes = ast.nodes();
+  for(std::size_t i = 0; i < nodes.size(); ++i)
+  {
+    const FlatNode &node = nodes[i];
+    switch(node.kind)
+    {
+      case FlatKind::NIL:
+      case FlatKind::FALSE:
+      case FlatKind::TRUE:
+        break;
+      case FlatKind::NUMBER:
+        if(node.lhs >= ast.numbers().size())
+        {
+          return false;
+        }
+        break;
+      case FlatKind::STRING:
+      {
+        if(node.lhs >= ast.strings().size())
+        {
+          return false;
+        }
+        const auto &ref = ast.strings()[node.lhs];
+        if(ref.offset > ast.chars().size() ||
+           ref.length > ast.chars().size() - ref.offset)
+        {
+          return false;
+        }
+        // 驻留编号不进缓存, 文件里的编号在当前的驻留表里没有意义
+        if(node.rhs != kNoSymbol)
+        {
+          return false;
+        }
+        break;
+      }
+      case FlatKind::BINARY:
+        if(node.rhs >= i)
+        {
+          return false;
+        }
+        [[fallthrough]];
+      case FlatKind::UNARY:
+      case FlatKind::GROUPING:
+        if(node.lhs >= i)
+        {
+          return false;
+        }
+        break;
+      default:
+        return false;
+    }
+    if(node.offset != kNoOffset && node.offset > source_size)
+    {
+      return false;
+    }
+  }
+  std::size_t next = 0;
+  for(std::uint32_t root : ast.roots())
+  {
+    if(root < next || root >= nodes.size())
+    {
+      return false;
+    }
+    next = root + 1;
+  }
+  return true;
+}
+} // namespace
+
+std::optional<CachedProgram>
+ProgramCache::load(std::string_view source) const
+{
+  CachedProgram program;
+  program.file_ = Source{path_for(source)};
+  if(!program.file_.is_open())
+  {
+    return std::nullopt;
+  }
+  std::string_view file = program.file_.view();
+  if(file.size() < sizeof(CacheHeader))
+  {
+    return std::nullopt;
+  }
+  CacheHeader header;
+  std::memcpy(&header, file.data(), sizeof(header));
+  if(header.magic != kMagic || header.version != kVersion ||
+     header.byte_order != kByteOrder || header.source_size != source.size() ||
+     header.source_hash != hash(source))
+  {
+    return std::nullopt;
+  }
+
+  std::span<const FlatNode> nodes;
+  std::span<const std::uint32_t> roots;
+  std::span<const double> numbers;
+  std::span<const FlatAst::StringRef> strings;
+  std::span<const char> chars;
+  const auto &sections = header.sections;
+  if(!section_view(file, sections[TOKEN_TYPES], program.types_) ||
+     !section_view(file, sections[TOKEN_OFFSETS], program.offsets_) ||
+     !section_view(file, sections[TOKEN_LENGTHS], program.lengths_) ||
+     !section_view(file, sections[AST_NODES], nodes) ||
+     !section_view(file, sections[AST_ROOTS], roots) ||
+     !section_view(file, sections[AST_NUMBERS], numbers) ||
+     !section_view(file, sections[AST_STRINGS], strings) ||
+     !section_view(file, sections[AST_CHARS], chars))
+  {
+    return std::nullopt;
+  }
+
+  const std::size_t count = program.types_.size();
+  if(program.offsets_.size() != count || program.lengths_.size() != count)
+  {
+    return std::nullopt;
+  }
+  for(std::size_t i = 0; i < count; ++i)
+  {
+    if(program.types_[i] > TokenType::LOX_EOF ||
+       program.offsets_[i] > source.size() ||
+       program.lengths_[i] > source.size() - program.offsets_[i])
+    {
+      return std::nullopt;
+    }
+  }
+
+  program.source_ = source;
+  program.ast_ = FlatAst::view(nodes,
+                               roots,
+                               numbers,
+                               strings,
+                               {chars.data(), chars.size()},
+                               source);
+  if(!validate(program.ast_, source.size()))
+  {
+    return std::nullopt;
+  }
+  return program;
+}
+
+bool
+ProgramCache::store(std::string_view source,
+                    std::span<const Token> tokens,
+                    const FlatAst &ast) const
+{
+  std::vector<std::uint8_t> types;
+  std::vector<std::uint32_t> offsets;
+  std::vector<std::uint32_t> lengths;
+  types.reserve(tokens.size());
+  offsets.reserve(tokens.size());
+  lengths.reserve(tokens.size());
+  for(const auto &token : tokens)
+  {
+    auto lexeme = token.get_lexeme();
+    types.push_back(static_cast<std::uint8_t>(token.get_type()));
+    offsets.push_back(
+        static_cast<std::uint32_t>(lexeme.data() - source.data()));
+    lengths.push_back(static_cast<std::uint32_t>(lexeme.size()));
+  }
+  // 驻留编号只在当前进程的驻留表里有意义
+  std::vector<FlatNode> nodes(ast.nodes().begin(), ast.nodes().end());
+  for(auto &node : nodes)
+  {
+    if(node.kind == FlatKind::STRING)
+    {
+      node.rhs = kNoSymbol;
+    }
+  }
+
+  CacheHeader header{};
+  header.magic = kMagic;
+  header.version = kVersion;
+  header.byte_order = kByteOrder;
+  header.source_hash = hash(source);
+  header.source_size = source.size();
+
+  std::vector<char> image(sizeof(CacheHeader));
+  auto &sections = header.sections;
+  sections[TOKEN_TYPES] =
+      append(image, std::span<const std::uint8_t>{types});
+  sections[TOKEN_OFFSETS] =
+      append(image, std::span<const std::uint32_t>{offsets});
+  sections[TOKEN_LENGTHS] =
+      append(image, std::span<const std::uint32_t>{lengths});
+  sections[AST_NODES] = append(image, std::span<const FlatNode>{nodes});
+  sections[AST_ROOTS] = append(image, ast.roots());
+  sections[AST_NUMBERS] = append(image, ast.numbers());
+  sections[AST_STRINGS] = append(image, ast.strings());
+  sections[AST_CHARS] =
+      append(image, std::span<const char>{ast.chars().data(),
+                                          ast.chars().size()});
+  std::memcpy(image.data(), &header, sizeof(header));
+
+  std::error_code ec;
+  std::filesystem::create_directories(directory_, ec);
+  const std::string path = path_for(source);
+  // 每个写者一个新建的临时文件, 同一进程里的多个线程同时写同一份源码也互不干扰
+  std::string tmp = path + ".XXXXXX";
+  int fd = ::mkostemp(tmp.data(), O_CLOEXEC);
+  if(fd < 0)
+  {
+    return false;
+  }
+  // mkostemp 创建的文件只有属主可读
+  ::fchmod(fd, 0644);
+  std::size_t written = 0;
+  while(written < image.size())
+  {
+    ssize_t n = ::write(fd, image.data() + written, image.size() - written);
+    if(n <= 0)
+    {
+      ::close(fd);
+      ::unlink(tmp.c_str());
+      return false;
+    }
+    written += static_cast<std::size_t>(n);
+  }
+  ::close(fd);
+  // rename 是原子的, 读者要么看到旧文件, 要么看到完整的新文件
+  if(::rename(tmp.c_str(), path.c_str()) != 0)
+  {
+    ::unlink(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+std::string
+ProgramCache::path_for(std::string_view source) const
+{
+  return std::format("{}/{:016x}.loxc", directory_, hash(source));
+}
+
+std::uint64_t
+ProgramCache::hash(std::string_view source)
+{
+  constexpr std::uint64_t m = 0xc6a4a7935bd1e995ULL;
+  constexpr int r = 47;
+  std::uint64_t h = 0x9e3779b97f4a7c15ULL ^ (source.size() * m);
+
+  const char *p = source.data();
+  const char *end = p + (source.size() & ~std::size_t{7});
+  for(; p != end; p += 8)
+  {
+    std::uint64_t k;
+    std::memcpy(&k, p, 8);
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+    h ^= k;
+    h *= m;
+  }
+
+  const std::size_t rest = source.size() & 7;
+  if(rest != 0)
+  {
+    std::uint64_t k = 0;
+    std::memcpy(&k, p, rest);
+    h ^= k;
+    h *= m;
+  }
+
+  h ^= h >> r;
+  h *= m;
+  h ^= h >> r;
+  return h;
+}
+} // namespace beacon_lox
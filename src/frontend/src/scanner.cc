@@ -0,0 +1,392 @@
+#include "simd_scan.hh"
+#include "unicode.hh"
+
+#include <cstdint>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace beacon_lox::simd
+{
+namespace
+{
+bool
+is_blank(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+bool
+is_digit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+bool
+is_alpha_digit(char c)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' ||
+         is_digit(c);
+}
+
+#if defined(__AVX2__) || defined(__SSE2__)
+
+#if defined(__AVX2__)
+using Vec = __m256i;
+constexpr std::size_t kWidth = 32;
+
+Vec
+load(const char *p)
+{
+  return _mm256_loadu_si256(reinterpret_cast<const Vec *>(p));
+}
+Vec
+splat(char c)
+{
+  return _mm256_set1_epi8(c);
+}
+Vec
+eq(Vec a, Vec b)
+{
+  return _mm256_cmpeq_epi8(a, b);
+}
+Vec
+bit_or(Vec a, Vec b)
+{
+  return _mm256_or_si256(a, b);
+}
+// 无符号比较: lo <= x <= hi  <=>  min(x - lo, hi - lo) == x - lo
+Vec
+in_range(Vec x, char lo, char hi)
+{
+  Vec off = _mm256_sub_epi8(x, splat(lo));
+  return eq(_mm256_min_epu8(off, splat(static_cast<char>(hi - lo))), off);
+}
+std::uint32_t
+mask(Vec v)
+{
+  return static_cast<std::uint32_t>(_mm256_movemask_epi8(v));
+}
+#else
+using Vec = __m128i;
+constexpr std::size_t kWidth = 16;
+
+Vec
+load(const char *p)
+{
+  return _mm_loadu_si128(reinterpret_cast<const Vec *>(p));
+}
+Vec
+splat(char c)
+{
+  return _mm_set1_epi8(c);
+}
+Vec
+eq(Vec a, Vec b)
+{
+  return _mm_cmpeq_epi8(a, b);
+}
+Vec
+bit_or(Vec a, Vec b)
+{
+  return _mm_or_si128(a, b);
+}
+Vec
+in_range(Vec x, char lo, char hi)
+{
+  Vec off = _mm_sub_epi8(x, splat(lo));
+  return eq(_mm_min_epu8(off, splat(static_cast<char>(hi - lo))), off);
+}
+std::uint32_t
+mask(Vec v)
+{
+  return static_cast<std::uint32_t>(_mm_movemask_epi8(v));
+}
+#endif
+
+constexpr std::uint32_t kFullMask =
+    kWidth == 32 ? 0xffffffffU : ((1U << kWidth) - 1);
+
+Vec
+blank_class(Vec v)
+{
+  return bit_or(bit_or(eq(v, splat(' ')), eq(v, splat('\t'))),
+                bit_or(eq(v, splat('\r')), eq(v, splat('\n'))));
+}
+
+Vec
+alpha_digit_class(Vec v)
+{
+  // 'a'-'z' 和 'A'-'Z' 只差 0x20 这一位, 合并成一次范围比较
+  Vec lower = bit_or(v, splat(0x20));
+  return bit_or(bit_or(in_range(lower, 'a', 'z'), in_range(v, '0', '9')),
+                eq(v, splat('_')));
+}
+
+Vec
+digit_class(Vec v)
+{
+  return in_range(v, '0', '9');
+}
+
+// 找到第一个不属于 Class 的字节, 返回前面连续属于 Class 的字节数
+template <typename Class, typename Scalar>
+std::size_t
+run_while(const char *begin, const char *end, Class cls, Scalar scalar)
+{
+  const char *p = begin;
+  while(static_cast<std::size_t>(end - p) >= kWidth)
+  {
+    std::uint32_t miss = ~mask(cls(load(p))) & kFullMask;
+    if(miss != 0)
+    {
+      return (p - begin) + __builtin_ctz(miss);
+    }
+    p += kWidth;
+  }
+  while(p < end && scalar(*p))
+  {
+    ++p;
+  }
+  return p - begin;
+}
+
+// 找到第一个等于 stop 的字节
+std::size_t
+run_until(const char *begin, const char *end, char stop)
+{
+  const char *p = begin;
+  while(static_cast<std::size_t>(end - p) >= kWidth)
+  {
+    std::uint32_t hit = mask(eq(load(p), splat(stop)));
+    if(hit != 0)
+    {
+      return (p - begin) + __builtin_ctz(hit);
+    }
+    p += kWidth;
+  }
+  while(p < end && *p != stop)
+  {
+    ++p;
+  }
+  return p - begin;
+}
+
+// 连续的 ASCII 字节数, movemask 取的正好是每个字节的最高位
+std::size_t
+ascii_prefix(const char *begin, const char *end)
+{
+  const char *p = begin;
+  while(static_cast<std::size_t>(end - p) >= kWidth)
+  {
+    std::uint32_t high = mask(load(p));
+    if(high != 0)
+    {
+      return (p - begin) + __builtin_ctz(high);
+    }
+    p += kWidth;
+  }
+  while(p < end && (static_cast<unsigned char>(*p) & 0x80) == 0)
+  {
+    ++p;
+  }
+  return p - begin;
+}
+
+// 对每个 '\n' 调用 visit(相对 begin 的偏移)
+template <typename Visit>
+void
+for_each_newline(const char *begin, const char *end, Visit visit)
+{
+  const char *p = begin;
+  while(static_cast<std::size_t>(end - p) >= kWidth)
+  {
+    std::uint32_t nl = mask(eq(load(p), splat('\n')));
+    while(nl != 0)
+    {
+      visit(static_cast<std::size_t>(p - begin) + __builtin_ctz(nl));
+      nl &= nl - 1;
+    }
+    p += kWidth;
+  }
+  for(; p < end; ++p)
+  {
+    if(*p == '\n')
+    {
+      visit(static_cast<std::size_t>(p - begin));
+    }
+  }
+}
+
+std::size_t
+count_newlines_impl(const char *begin, const char *end)
+{
+  std::size_t count = 0;
+  const char *p = begin;
+  while(static_cast<std::size_t>(end - p) >= kWidth)
+  {
+    count += __builtin_popcount(mask(eq(load(p), splat('\n'))));
+    p += kWidth;
+  }
+  for(; p < end; ++p)
+  {
+    count += *p == '\n' ? 1 : 0;
+  }
+  return count;
+}
+
+#else
+
+template <typename Class, typename Scalar>
+std::size_t
+run_while(const char *begin, const char *end, Class /*cls*/, Scalar scalar)
+{
+  const char *p = begin;
+  while(p < end && scalar(*p))
+  {
+    ++p;
+  }
+  return p - begin;
+}
+
+std::size_t
+run_until(const char *begin, const char *end, char stop)
+{
+  const char *p = begin;
+  while(p < end && *p != stop)
+  {
+    ++p;
+  }
+  return p - begin;
+}
+
+std::size_t
+ascii_prefix(const char *begin, const char *end)
+{
+  const char *p = begin;
+  while(p < end && (static_cast<unsigned char>(*p) & 0x80) == 0)
+  {
+    ++p;
+  }
+  return p - begin;
+}
+
+template <typename Visit>
+void
+for_each_newline(const char *begin, const char *end, Visit visit)
+{
+  for(const char *p = begin; p < end; ++p)
+  {
+    if(*p == '\n')
+    {
+      visit(static_cast<std::size_t>(p - begin));
+    }
+  }
+}
+
+std::size_t
+count_newlines_impl(const char *begin, const char *end)
+{
+  std::size_t count = 0;
+  for(const char *p = begin; p < end; ++p)
+  {
+    count += *p == '\n' ? 1 : 0;
+  }
+  return count;
+}
+
+// 没有向量指令时, 分类函数只是个占位
+struct NoVector
+{};
+constexpr NoVector blank_class{};
+constexpr NoVector alpha_digit_class{};
+constexpr NoVector digit_class{};
+
+#endif
+} // namespace
+
+
+std::size_t
+skip_blank(const char *begin, const char *end)
+{
+  return run_while(begin, end, blank_class, is_blank);
+}
+
+std::size_t
+skip_alpha_digit(const char *begin, const char *end)
+{
+  return run_while(begin, end, alpha_digit_class, is_alpha_digit);
+}
+
+std::size_t
+skip_digit(const char *begin, const char *end)
+{
+  return run_while(begin, end, digit_class, is_digit);
+}
+
+std::size_t
+skip_line(const char *begin, const char *end)
+{
+  return run_until(begin, end, '\n');
+}
+
+std::size_t
+skip_string(const char *begin, const char *end)
+{
+  return run_until(begin, end, '"');
+}
+
+std::size_t
+count_newlines(const char *begin, const char *end)
+{
+  return count_newlines_impl(begin, end);
+}
+
+void
+line_starts(const char *begin,
+            const char *end,
+            std::vector<std::uint32_t> &starts)
+{
+  starts.reserve(starts.size() + count_newlines_impl(begin, end));
+  for_each_newline(
+      begin,
+      end,
+      [&starts](std::size_t offset)
+      { starts.push_back(static_cast<std::uint32_t>(offset + 1)); });
+}
+
+std::size_t
+validate_utf8(const char *begin, const char *end)
+{
+  const char *p = begin;
+  for(;;)
+  {
+    p += ascii_prefix(p, end);
+    if(p == end)
+    {
+      return p - begin;
+    }
+    char32_t cp = 0;
+    std::size_t len = unicode::decode(p, end, cp);
+    if(len == 0)
+    {
+      return p - begin;
+    }
+    p += len;
+  }
+}
+
+const char *
+kernel_name()
+{
+#if defined(__AVX2__)
+  return "avx2";
+#elif defined(__SSE2__)
+  return "sse2";
+#else
+  return "scalar";
+#endif
+}
+} // namespace beacon_lox::simd
@@ -0,0 +1,123 @@
+#include "source.hh"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <utility>
+
+namespace beacon_lox
+{
+Source::Source(const std::string &path)
+{
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if(fd < 0)
+  {
+    return;
+  }
+
+  struct stat st
+  {};
+  if(::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+  {
+    void *addr = ::mmap(nullptr,
+                        static_cast<std::size_t>(st.st_size),
+                        PROT_READ,
+                        MAP_PRIVATE,
+                        fd,
+                        0);
+    if(addr != MAP_FAILED)
+    {
+      // 扫描是从头到尾顺序读的
+      ::madvise(addr, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+      map_ = addr;
+      size_ = static_cast<std::size_t>(st.st_size);
+      open_ = true;
+      ::close(fd);
+      return;
+    }
+  }
+
+  // 空文件, 管道, 或者 mmap 失败, 都走读缓冲区
+  open_ = read_fd(fd);
+  ::close(fd);
+}
+
+Source
+Source::from_string(std::string_view contents)
+{
+  Source source;
+  source.buffer_.assign(contents.begin(), contents.end());
+  source.open_ = true;
+  return source;
+}
+
+Source::Source(Source &&other) noexcept
+  : map_(std::exchange(other.map_, nullptr))
+  , size_(std::exchange(other.size_, 0))
+  , buffer_(std::move(other.buffer_))
+  , open_(std::exchange(other.open_, false))
+{}
+
+Source &
+Source::operator=(Source &&other) noexcept
+{
+  if(this != &other)
+  {
+    release();
+    map_ = std::exchange(other.map_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+    buffer_ = std::move(other.buffer_);
+    open_ = std::exchange(other.open_, false);
+  }
+  return *this;
+}
+
+Source::~Source()
+{
+  release();
+}
+
+void
+Source::release()
+{
+  if(map_ != nullptr)
+  {
+    ::munmap(map_, size_);
+    map_ = nullptr;
+    size_ = 0;
+  }
+  buffer_.clear();
+  open_ = false;
+}
+
+bool
+Source::read_fd(int fd)
+{
+  constexpr std::size_t kChunk = 64 * 1024;
+  std::size_t used = 0;
+  for(;;)
+  {
+    buffer_.resize(used + kChunk);
+    ssize_t n = ::read(fd, buffer_.data() + used, kChunk);
+    if(n < 0)
+    {
+      if(errno == EINTR)
+      {
+        continue;
+      }
+      buffer_.clear();
+      return false;
+    }
+    if(n == 0)
+    {
+      break;
+    }
+    used += static_cast<std::size_t>(n);
+  }
+  buffer_.resize(used);
+  return true;
+}
+} // namespace beacon_lox
@@ -0,0 +1,168 @@
+#include "unicode.hh"
+#include "simd_scan.hh"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace beacon_lox::unicode
+{
+namespace
+{
+struct Range
+{
+  char32_t lo;
+  char32_t hi;
+};
+
+#include "unicode_xid.inc"
+
+template <std::size_t N>
+bool
+in_table(const Range (&table)[N], char32_t cp)
+{
+  // 第一个 hi >= cp 的区间
+  const Range *it =
+      std::lower_bound(table,
+                       table + N,
+                       cp,
+                       [](const Range &range, char32_t key)
+                       { return range.hi < key; });
+  return it != table + N && it->lo <= cp;
+}
+
+bool
+is_ascii(char c)
+{
+  return (static_cast<unsigned char>(c) & 0x80) == 0;
+}
+
+bool
+is_continuation(unsigned char c)
+{
+  return (c & 0xC0) == 0x80;
+}
+} // namespace
+
+
+std::size_t
+decode(const char *begin, const char *end, char32_t &cp)
+{
+  const auto *p = reinterpret_cast<const unsigned char *>(begin);
+  const std::size_t avail = end - begin;
+  if(avail == 0)
+  {
+    return 0;
+  }
+  if(p[0] < 0x80)
+  {
+    cp = p[0];
+    return 1;
+  }
+
+  std::size_t len = 0;
+  char32_t min = 0;
+  if((p[0] & 0xE0) == 0xC0)
+  {
+    len = 2;
+    min = 0x80;
+    cp = p[0] & 0x1F;
+  }
+  else if((p[0] & 0xF0) == 0xE0)
+  {
+    len = 3;
+    min = 0x800;
+    cp = p[0] & 0x0F;
+  }
+  else if((p[0] & 0xF8) == 0xF0)
+  {
+    len = 4;
+    min = 0x10000;
+    cp = p[0] & 0x07;
+  }
+  else
+  {
+    return 0;
+  }
+  if(avail < len)
+  {
+    return 0;
+  }
+  for(std::size_t i = 1; i < len; ++i)
+  {
+    if(!is_continuation(p[i]))
+    {
+      return 0;
+    }
+    cp = (cp << 6) | (p[i] & 0x3F);
+  }
+  if(cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+  {
+    return 0;
+  }
+  return len;
+}
+
+bool
+is_xid_start(char32_t cp)
+{
+  return in_table(kXidStart, cp);
+}
+
+bool
+is_xid_continue(char32_t cp)
+{
+  return in_table(kXidContinue, cp);
+}
+
+std::size_t
+identifier_start(const char *begin, const char *end)
+{
+  char32_t cp = 0;
+  std::size_t len = decode(begin, end, cp);
+  return len > 1 && is_xid_start(cp) ? len : 0;
+}
+
+std::size_t
+skip_identifier(const char *begin, const char *end)
+{
+  const char *p = begin;
+  for(;;)
+  {
+    p += simd::skip_alpha_digit(p, end);
+    if(p == end || is_ascii(*p))
+    {
+      return p - begin;
+    }
+    char32_t cp = 0;
+    std::size_t len = decode(p, end, cp);
+    if(len == 0 || !is_xid_continue(cp))
+    {
+      return p - begin;
+    }
+    p += len;
+  }
+}
+
+std::size_t
+skip_unknown(const char *begin, const char *end)
+{
+  const char *p = begin;
+  while(p != end && !is_ascii(*p))
+  {
+    char32_t cp = 0;
+    std::size_t len = decode(p, end, cp);
+    if(len == 0)
+    {
+      // 非法字节一个一个跳过, 下一个字节可能是新字符的开头
+      ++p;
+      continue;
+    }
+    if(is_xid_start(cp))
+    {
+      break;
+    }
+    p += len;
+  }
+  return p - begin;
+}
+} // namespace beacon_lox::unicode
@@ -0,0 +1,172 @@
+#include "ast.hh"
+#include "ast_dump.hh"
+#include "compilation_unit.hh"
+
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// 流式导出: S 表达式必须和 ExprVisitor 的输出相同, token 必须和逐个 format 的输出相同
+// 然后比较两种方式导出一个几 MB 的程序的时间
+
+
+std::string
+print(const beacon_lox::Expr &expr)
+{
+  beacon_lox::ExprVisitor visitor;
+  return std::any_cast<std::string>(
+      std::visit([&visitor](const auto &value) -> std::any
+                 { return value->accept(&visitor); },
+                 expr));
+}
+
+std::string
+sexpr(const beacon_lox::Expr &expr)
+{
+  std::string text;
+  beacon_lox::dump_expr(expr, std::back_inserter(text));
+  return text;
+}
+
+int
+main(int /*argc*/, char ** /*argv*/)
+{
+  int failed = 0;
+
+  auto unit = beacon_lox::CompilationUnit::from_string(
+      "1 + 2 * 3;\n-(1 - 2.5) / (4);\n\"a\\tb\" == nil != !true;\n"
+      "1 <= 2 > 3 < 4 >= 5;\n1000000 * 0.000001");
+  unit.parse();
+  for(const auto &expr : unit.exprs())
+  {
+    if(sexpr(expr) != print(expr))
+    {
+      std::cout << std::format("sexpr differs:\n  got  {}\n  want {}\n",
+                               sexpr(expr),
+                               print(expr));
+      ++failed;
+    }
+  }
+
+  std::string tokens;
+  beacon_lox::dump_tokens(unit.tokens(), std::back_inserter(tokens));
+  std::string expect_tokens;
+  for(const auto &token : unit.tokens())
+  {
+    expect_tokens += std::format("{} {} {}\n",
+                                 token.get_type(),
+                                 token.get_lexeme(),
+                                 token.get_literal());
+  }
+  if(tokens != expect_tokens)
+  {
+    std::cout << std::format("tokens differ:\n{}\n{}", tokens, expect_tokens);
+    ++failed;
+  }
+
+  std::string json;
+  beacon_lox::dump_expr(unit.exprs()[2],
+                        std::back_inserter(json),
+                        beacon_lox::DumpFormat::JSON);
+  const std::string_view expect_json =
+      R"({"kind":"binary","op":"BANG_EQUAL","lexeme":"!=",)"
+      R"("left":{"kind":"binary","op":"EQUAL_EQUAL","lexeme":"==",)"
+      R"("left":{"kind":"literal","value":"a\\tb"},)"
+      R"("right":{"kind":"literal","value":null}},)"
+      R"("right":{"kind":"unary","op":"BANS","lexeme":"!",)"
+      R"("operand":{"kind":"literal","value":true}}})";
+  if(json != expect_json)
+  {
+    std::cout << std::format("json differs:\n  got  {}\n  want {}\n",
+                             json,
+                             expect_json);
+    ++failed;
+  }
+  std::string json_tokens;
+  beacon_lox::dump_tokens(std::span{unit.tokens()}.first(3),
+                          std::back_inserter(json_tokens),
+                          beacon_lox::DumpFormat::JSON);
+  std::cout << json_tokens;
+
+  // 几 MB 的程序: 很多中等深度的表达式
+  std::string program;
+  for(int i = 0; i < 4000; ++i)
+  {
+    std::string expr = "1";
+    for(int j = 0; j < 100; ++j)
+    {
+      expr += j % 3 == 0 ? " + (2 * -3)"
+                         : (j % 3 == 1 ? " - \"s\" / 5" : " == !true");
+    }
+    program += expr + ";\n";
+  }
+  auto big = beacon_lox::CompilationUnit::from_string(program);
+  big.parse();
+
+  auto begin = std::chrono::steady_clock::now();
+  std::size_t visitor_bytes = 0;
+  for(const auto &expr : big.exprs())
+  {
+    visitor_bytes += print(expr).size() + 1;
+  }
+  std::chrono::duration<double> visitor_time =
+      std::chrono::steady_clock::now() - begin;
+
+  begin = std::chrono::steady_clock::now();
+  std::string out;
+  for(const auto &expr : big.exprs())
+  {
+    beacon_lox::dump_expr(expr, std::back_inserter(out));
+    out += '\n';
+  }
+  std::chrono::duration<double> dump_time =
+      std::chrono::steady_clock::now() - begin;
+
+  begin = std::chrono::steady_clock::now();
+  std::string out_json;
+  for(const auto &expr : big.exprs())
+  {
+    beacon_lox::dump_expr(expr,
+                          std::back_inserter(out_json),
+                          beacon_lox::DumpFormat::JSON);
+    out_json += '\n';
+  }
+  std::chrono::duration<double> json_time =
+      std::chrono::steady_clock::now() - begin;
+
+  if(out.size() != visitor_bytes)
+  {
+    std::cout << "dump size differs from ExprVisitor\n";
+    ++failed;
+  }
+  std::cout << std::format(
+      "{} bytes source, {} bytes dumped: ExprVisitor {:.3f}s, "
+      "sexpr {:.3f}s, json {} bytes {:.3f}s\n",
+      program.size(),
+      out.size(),
+      visitor_time.count(),
+      dump_time.count(),
+      out_json.size(),
+      json_time.count());
+
+  // 很深的树: ExprVisitor 会栈溢出, 这里不会
+  std::string deep = "1";
+  for(int i = 0; i < 200000; ++i)
+  {
+    deep += " + 2";
+  }
+  auto deep_unit = beacon_lox::CompilationUnit::from_string(deep);
+  deep_unit.parse();
+  std::string deep_out;
+  beacon_lox::dump_expr(deep_unit.exprs().front(),
+                        std::back_inserter(deep_out),
+                        beacon_lox::DumpFormat::JSON);
+  std::cout << std::format("depth 200000: {} bytes of json\n",
+                           deep_out.size());
+
+  std::cout << (failed == 0 ? "all passed\n" : "FAILED\n");
+  return failed == 0 ? 0 : 1;
+}
@@ -69,14 +69,16 @@ to_string(const beacon_lox::Expr &expr)
 int
 main()
 {
+  // 节点都分配在 arena 里, 随它一起释放
+  beacon_lox::Arena arena;
   auto expr_liter1{std::make_unique<beacon_lox::Expr>(
-      std::make_unique<beacon_lox::LiteralExpr>("beacon"))};
+      arena.make<beacon_lox::LiteralExpr>("beacon"))};
   auto expr_liter2{std::make_unique<beacon_lox::Expr>(
-      std::make_unique<beacon_lox::LiteralExpr>(17.))};
+      arena.make<beacon_lox::LiteralExpr>(17.))};
   auto expr_liter3{std::make_unique<beacon_lox::Expr>(
-      std::make_unique<beacon_lox::LiteralExpr>(true))};
+      arena.make<beacon_lox::LiteralExpr>(true))};
   auto expr_liter4{std::make_unique<beacon_lox::Expr>(
-      std::make_unique<beacon_lox::LiteralExpr>("uan"))};
+      arena.make<beacon_lox::LiteralExpr>("uan"))};
 
 
   beacon_lox::ExprVisitor visitor;
@@ -99,16 +101,16 @@ main()
                                { return value->accept(&visitor); },
                                *expr_liter3)));
 
-  beacon_lox::Token t1{beacon_lox::TokenType::MINUS, "-", "-", 21};
-  beacon_lox::Token t2{beacon_lox::TokenType::BANS, "!", "!", 21};
-  beacon_lox::Token t3{beacon_lox::TokenType::EQUAL_EQUAL, "==", "==", 21};
-  beacon_lox::Token t4{beacon_lox::TokenType::BANG_EQUAL, "!=", "!=", 21};
+  beacon_lox::Token t1{beacon_lox::TokenType::MINUS, "-", "-"};
+  beacon_lox::Token t2{beacon_lox::TokenType::BANS, "!", "!"};
+  beacon_lox::Token t3{beacon_lox::TokenType::EQUAL_EQUAL, "==", "=="};
+  beacon_lox::Token t4{beacon_lox::TokenType::BANG_EQUAL, "!=", "!="};
 
 
   beacon_lox::Expr expr_unary1{
-      std::make_unique<beacon_lox::UnaryExpr>(std::move(*expr_liter1),
-                                              t1,
-                                              beacon_lox::UnaryOp::MINUS)};
+      arena.make<beacon_lox::UnaryExpr>(std::move(*expr_liter1),
+                                        t1,
+                                        beacon_lox::UnaryOp::MINUS)};
   // (MINUS - (beacon))
   std::cout << std::format("expr_unary1:  {}\n",
                            std::any_cast<std::string>(std::visit(
@@ -116,9 +118,9 @@ main()
                                { return value->accept(&visitor); },
                                expr_unary1)));
   beacon_lox::Expr expr_unary2{
-      std::make_unique<beacon_lox::UnaryExpr>(std::move(*expr_liter2),
-                                              t2,
-                                              beacon_lox::UnaryOp::BANS)};
+      arena.make<beacon_lox::UnaryExpr>(std::move(*expr_liter2),
+                                        t2,
+                                        beacon_lox::UnaryOp::BANS)};
   // (BANS ! (17))
   std::cout << std::format("expr_unary2:  {}\n",
                            std::any_cast<std::string>(std::visit(
@@ -126,16 +128,16 @@ main()
                                { return value->accept(&visitor); },
                                expr_unary2)));
   beacon_lox::Expr expr_unary3{
-      std::make_unique<beacon_lox::UnaryExpr>(std::move(*expr_liter3),
-                                              t2,
-                                              beacon_lox::UnaryOp::BANS)};
+      arena.make<beacon_lox::UnaryExpr>(std::move(*expr_liter3),
+                                        t2,
+                                        beacon_lox::UnaryOp::BANS)};
   // (BANS ! (true))
   std::cout << std::format("expr_unary3:  {}\n",
                            std::any_cast<std::string>(std::visit(
                                [&visitor](const auto &value) -> std::any
                                { return value->accept(&visitor); },
                                expr_unary3)));
-  beacon_lox::Expr expr_binary1{std::make_unique<beacon_lox::BinaryExpr>(
+  beacon_lox::Expr expr_binary1{arena.make<beacon_lox::BinaryExpr>(
       std::move(expr_unary1),
       t3,
       beacon_lox::BinaryOp::EQUAL_EQUAL,
@@ -146,10 +148,10 @@ main()
                                { return value->accept(&visitor); },
                                expr_binary1)));
   beacon_lox::Expr expr_binary2{
-      std::make_unique<beacon_lox::BinaryExpr>(std::move(expr_binary1),
-                                               t4,
-                                               beacon_lox::BinaryOp::BANG_EQUAL,
-                                               std::move(expr_unary3))};
+      arena.make<beacon_lox::BinaryExpr>(std::move(expr_binary1),
+                                         t4,
+                                         beacon_lox::BinaryOp::BANG_EQUAL,
+                                         std::move(expr_unary3))};
   std::cout << std::format("expr_binary2:  {}\n",
                            std::any_cast<std::string>(std::visit(
                                [&visitor](const auto &value) -> std::any
@@ -162,40 +164,41 @@ main()
 int
 main2()
 {
+  beacon_lox::Arena arena;
   beacon_lox::Literal li("beacon");
   beacon_lox::Expr expr;
-  expr = std::make_unique<beacon_lox::LiteralExpr>(li);
+  expr = arena.make<beacon_lox::LiteralExpr>(li);
   std::cout << std::format("{}\n", to_string(expr));
 
 
-  beacon_lox::Token minus(beacon_lox::TokenType::MINUS, "-", "-", 2);
+  beacon_lox::Token minus(beacon_lox::TokenType::MINUS, "-", "-");
   beacon_lox::Expr unary{
-      std::make_unique<beacon_lox::UnaryExpr>(std::move(expr),
-                                              minus,
-                                              beacon_lox::UnaryOp::MINUS)};
+      arena.make<beacon_lox::UnaryExpr>(std::move(expr),
+                                        minus,
+                                        beacon_lox::UnaryOp::MINUS)};
   std::cout << std::format("{}\n", to_string(unary));
 
-  beacon_lox::Expr b2{std::make_unique<beacon_lox::UnaryExpr>(
-      std::make_unique<beacon_lox::LiteralExpr>(
+  beacon_lox::Expr b2{arena.make<beacon_lox::UnaryExpr>(
+      arena.make<beacon_lox::LiteralExpr>(
           beacon_lox::Literal((float)17.2156487)),
       minus,
       beacon_lox::UnaryOp::MINUS)};
   std::cout << std::format("{}\n", to_string(b2));
 
   beacon_lox::Expr b3{
-      std::make_unique<beacon_lox::UnaryExpr>(std::move(b2),
-                                              minus,
-                                              beacon_lox::UnaryOp::MINUS)};
+      arena.make<beacon_lox::UnaryExpr>(std::move(b2),
+                                        minus,
+                                        beacon_lox::UnaryOp::MINUS)};
   std::cout << std::format("{}\n", to_string(b3));
 
 
-  beacon_lox::Token star{beacon_lox::TokenType::STAR, "*", "*", 3};
-  beacon_lox::Expr s{std::make_unique<beacon_lox::LiteralExpr>("17.364561")};
+  beacon_lox::Token star{beacon_lox::TokenType::STAR, "*", "*"};
+  beacon_lox::Expr s{arena.make<beacon_lox::LiteralExpr>("17.364561")};
   beacon_lox::Expr b4{
-      std::make_unique<beacon_lox::BinaryExpr>(std::move(b3),
-                                               star,
-                                               beacon_lox::BinaryOp::STAR,
-                                               std::move(s))};
+      arena.make<beacon_lox::BinaryExpr>(std::move(b3),
+                                         star,
+                                         beacon_lox::BinaryOp::STAR,
+                                         std::move(s))};
   std::cout << std::format("{}\n", to_string(b4));
 
   float ff = 23.42132;
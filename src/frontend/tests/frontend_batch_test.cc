@@ -0,0 +1,172 @@
+#include "ast.hh"
+#include "compilation_unit.hh"
+#include "frontend_batch.hh"
+#include "work_stealing_pool.hh"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// frontend_batch a.lox b.lox ...  并行解析给出的文件, 报告所有的语法错误
+// 不带参数时生成一批大小不一的文件, 并行的结果必须和逐个解析完全一致
+
+
+std::string
+print(const beacon_lox::Expr &expr)
+{
+  beacon_lox::ExprVisitor visitor;
+  return std::any_cast<std::string>(
+      std::visit([&visitor](const auto &value) -> std::any
+                 { return value->accept(&visitor); },
+                 expr));
+}
+
+// 一个文件的解析结果: 每个表达式的打印和所有的错误
+std::vector<std::string>
+summary(const std::string &path, const beacon_lox::CompilationUnit &unit)
+{
+  std::vector<std::string> lines;
+  for(const auto &expr : unit.exprs())
+  {
+    lines.push_back(print(expr));
+  }
+  beacon_lox::report_all(std::span<const std::string>{&path, 1},
+                         std::span<const beacon_lox::CompilationUnit>{&unit, 1},
+                         lines);
+  return lines;
+}
+
+std::string
+random_file(std::mt19937 &rng, std::size_t exprs)
+{
+  static const std::vector<std::string> pieces = {
+      "1", " + ", "2.5", " * ", "(", ")", " == ", "\"s\"", "-", "!", "true",
+      " < ", "nil", " / "};
+  std::uniform_int_distribution<std::size_t> pick(0, pieces.size() - 1);
+  std::uniform_int_distribution<int> len(1, 9);
+  std::string text;
+  for(std::size_t i = 0; i < exprs; ++i)
+  {
+    // 随机拼接, 大约一半的表达式有语法错误
+    int n = len(rng);
+    for(int j = 0; j < n; ++j)
+    {
+      text += pieces[pick(rng)];
+    }
+    text += ";\n";
+  }
+  return text;
+}
+
+int
+run_files(const std::vector<std::string> &paths)
+{
+  beacon_lox::WorkStealingPool pool;
+  auto units = beacon_lox::parse_files(paths, pool);
+  std::vector<std::string> errors;
+  for(std::size_t i = 0; i < units.size(); ++i)
+  {
+    if(!units[i].is_open())
+    {
+      errors.push_back(paths[i] + ": cannot open\n");
+      continue;
+    }
+    std::cout << std::format("{}: {} expressions\n",
+                             paths[i],
+                             units[i].exprs().size());
+  }
+  beacon_lox::report_all(paths, units, errors);
+  for(const auto &err : errors)
+  {
+    std::cout << err;
+  }
+  return errors.empty() ? 0 : 65;
+}
+
+int
+main(int argc, char **argv)
+{
+  if(argc > 1)
+  {
+    return run_files(std::vector<std::string>(argv + 1, argv + argc));
+  }
+
+  const auto dir = std::filesystem::temp_directory_path() /
+                   std::format("beacon_lox_batch_test_{}", ::getpid());
+  std::filesystem::create_directories(dir);
+  std::mt19937 rng(42);
+  // 大部分文件很小, 每 97 个里有一个大文件, 大文件决定了一个线程要做多久
+  std::vector<std::string> paths;
+  for(int i = 0; i < 2000; ++i)
+  {
+    std::size_t exprs = 1 + (i % 97 == 0 ? 2000 : rng() % 40);
+    auto path = (dir / std::format("rule_{}.lox", i)).string();
+    std::ofstream(path) << random_file(rng, exprs);
+    paths.push_back(path);
+  }
+  paths.push_back((dir / "missing.lox").string());
+
+  auto begin = std::chrono::steady_clock::now();
+  std::vector<beacon_lox::CompilationUnit> serial;
+  for(const auto &path : paths)
+  {
+    auto unit = beacon_lox::CompilationUnit::open(path);
+    if(unit.is_open())
+    {
+      unit.parse();
+    }
+    serial.push_back(std::move(unit));
+  }
+  std::chrono::duration<double> serial_time =
+      std::chrono::steady_clock::now() - begin;
+
+  // 至少 4 个线程, 单核机器上也能测到窃取
+  beacon_lox::WorkStealingPool pool(
+      std::max(4U, std::thread::hardware_concurrency()));
+  begin = std::chrono::steady_clock::now();
+  auto parallel = beacon_lox::parse_files(paths, pool);
+  std::chrono::duration<double> parallel_time =
+      std::chrono::steady_clock::now() - begin;
+
+  int failed = 0;
+  std::size_t errors = 0;
+  for(std::size_t i = 0; i < paths.size(); ++i)
+  {
+    if(serial[i].is_open() != parallel[i].is_open())
+    {
+      std::cout << std::format("{}: open differs\n", paths[i]);
+      ++failed;
+      continue;
+    }
+    auto expect = summary(paths[i], serial[i]);
+    auto got = summary(paths[i], parallel[i]);
+    errors += serial[i].diagnostics().size();
+    if(expect != got)
+    {
+      std::cout << std::format("{}: results differ\n", paths[i]);
+      ++failed;
+    }
+  }
+
+  std::cout << std::format(
+      "{} files, {} errors: serial {:.3f}s, {} threads {:.3f}s, {} steals\n",
+      paths.size(),
+      errors,
+      serial_time.count(),
+      pool.size(),
+      parallel_time.count(),
+      pool.steals());
+
+  std::filesystem::remove_all(dir);
+  std::cout << (failed == 0 ? "all passed\n" : "FAILED\n");
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,152 @@
+#include "scanner.hh"
+#include "token_buffer.hh"
+
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// 每次修改之后, 增量扫描的结果必须和整个重新扫描完全一致
+
+
+bool
+same_buffer(const beacon_lox::TokenBuffer &lhs,
+            const beacon_lox::TokenBuffer &rhs)
+{
+  if(lhs.size() != rhs.size())
+  {
+    std::cout << std::format("  size {} vs {}\n", lhs.size(), rhs.size());
+    return false;
+  }
+  for(std::size_t i = 0; i < lhs.size(); ++i)
+  {
+    if(lhs.type(i) != rhs.type(i) || lhs.offset(i) != rhs.offset(i) ||
+       lhs.length(i) != rhs.length(i) || lhs.literal(i) != rhs.literal(i) ||
+       lhs.symbol(i) != rhs.symbol(i))
+    {
+      std::cout << std::format("  token {}: {} '{}' at {} vs {} '{}' at {}\n",
+                               i,
+                               lhs.type(i),
+                               lhs.lexeme(i),
+                               lhs.offset(i),
+                               rhs.type(i),
+                               rhs.lexeme(i),
+                               rhs.offset(i));
+      return false;
+    }
+  }
+  return true;
+}
+
+// 增量扫描和整体扫描共用一个驻留表, 同一个名字的编号相同
+beacon_lox::SymbolTable symbols;
+
+beacon_lox::TokenBuffer
+full_scan(const std::string &text)
+{
+  beacon_lox::Scanner scanner{std::string_view(text)};
+  scanner.set_symbols(symbols);
+  return beacon_lox::TokenBuffer::scan(scanner);
+}
+
+std::string
+random_text(std::mt19937 &rng, std::size_t pieces)
+{
+  static const std::vector<std::string> fragments = {
+      "var", "x",  "1",  "2.5", ".",   "\"", "\"s\"", "//", "/", "\n",
+      " ",   "\n", "(",  ")",   "=",   "!",  "<",     "+",  ";", "or"};
+  std::uniform_int_distribution<std::size_t> pick(0, fragments.size() - 1);
+  std::string out;
+  for(std::size_t i = 0; i < pieces; ++i)
+  {
+    out += fragments[pick(rng)];
+  }
+  return out;
+}
+
+int
+main(int /*argc*/, char ** /*argv*/)
+{
+  std::mt19937 rng(11);
+  int failures = 0;
+  for(int round = 0; round < 200 && failures == 0; ++round)
+  {
+    std::string text = random_text(rng, 1 + round % 80);
+    auto buffer = full_scan(text);
+    for(int step = 0; step < 100; ++step)
+    {
+      std::uniform_int_distribution<std::size_t> at(0, text.size());
+      auto offset = at(rng);
+      std::uniform_int_distribution<std::size_t> len(
+          0,
+          std::min<std::size_t>(4, text.size() - offset));
+      auto removed = len(rng);
+      auto inserted = random_text(rng, step % 3);
+
+      text.replace(offset, removed, inserted);
+      buffer.apply_edit(text,
+                        {static_cast<std::uint32_t>(offset),
+                         static_cast<std::uint32_t>(removed),
+                         static_cast<std::uint32_t>(inserted.size())});
+      if(!same_buffer(buffer, full_scan(text)))
+      {
+        std::cout << std::format("mismatch after edit at {} (-{} +'{}'): [{}]\n",
+                                 offset,
+                                 removed,
+                                 inserted,
+                                 text);
+        ++failures;
+        break;
+      }
+    }
+  }
+  if(failures != 0)
+  {
+    return 1;
+  }
+  std::cout << "incremental scan matches Scanner\n";
+
+  // 大文件里逐个字符地输入, 对比每次整体重新扫描
+  std::string big;
+  while(big.size() < (4U << 20))
+  {
+    big += "var total_42 = (alpha + 3.25) * beta - \"text\"; // comment\n";
+  }
+  auto buffer = full_scan(big);
+  const std::string typed = "print total_42 + 1;\n";
+  std::size_t offset = big.size() / 2;
+  offset = big.find('\n', offset) + 1;
+  std::size_t relexed = 0;
+  // 输入两行, 只计 apply_edit 的时间, 修改 std::string 本身就要搬动后半个文件
+  // 第一行里 token 数第一次变化时要在列里开出空隙, 和文件大小有关, 第二行就只和修改有关
+  std::chrono::duration<double> lines[2]{};
+  for(auto &line : lines)
+  {
+    for(std::size_t i = 0; i < typed.size(); ++i)
+    {
+      big.insert(offset + i, 1, typed[i]);
+      auto begin = std::chrono::steady_clock::now();
+      relexed += buffer.apply_edit(
+          big,
+          {static_cast<std::uint32_t>(offset + i), 0, 1});
+      line += std::chrono::steady_clock::now() - begin;
+    }
+    offset += typed.size();
+  }
+
+  auto begin = std::chrono::steady_clock::now();
+  auto full = full_scan(big);
+  std::chrono::duration<double> rescan =
+      std::chrono::steady_clock::now() - begin;
+
+  std::cout << std::format("{} edits: {} tokens relexed, first line {:.6f}s, "
+                           "second line {:.6f}s; one full rescan: {:.6f}s\n",
+                           typed.size() * 2,
+                           relexed,
+                           lines[0].count(),
+                           lines[1].count(),
+                           rescan.count());
+  return same_buffer(buffer, full) ? 0 : 1;
+}
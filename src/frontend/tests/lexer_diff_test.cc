@@ -0,0 +1,202 @@
+#include "dfa_scanner.hh"
+#include "line_index.hh"
+#include "scanner.hh"
+#include "source.hh"
+
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// 差分测试: 同一份输入分别交给 Scanner 和 DfaScanner, token 序列必须完全一致
+// 同时用逐字节数换行的结果检查 LineIndex
+// 最后在一份较大的生成程序上比较两者的吞吐
+
+
+bool
+same_tokens(const std::vector<beacon_lox::Token> &lhs,
+            const std::vector<beacon_lox::Token> &rhs)
+{
+  if(lhs.size() != rhs.size())
+  {
+    return false;
+  }
+  for(std::size_t i = 0; i < lhs.size(); ++i)
+  {
+    if(lhs[i].get_type() != rhs[i].get_type() ||
+       lhs[i].get_lexeme().data() != rhs[i].get_lexeme().data() ||
+       lhs[i].get_lexeme().size() != rhs[i].get_lexeme().size() ||
+       lhs[i].get_literal() != rhs[i].get_literal())
+    {
+      std::cout << std::format("  token {}: {} '{}' vs {} '{}'\n",
+                               i,
+                               lhs[i].get_type(),
+                               lhs[i].get_lexeme(),
+                               rhs[i].get_type(),
+                               rhs[i].get_lexeme());
+      return false;
+    }
+  }
+  return true;
+}
+
+bool
+same_locations(std::string_view source)
+{
+  beacon_lox::LineIndex lines(source);
+  unsigned int line = 1;
+  unsigned int column = 1;
+  for(std::size_t offset = 0; offset <= source.size(); ++offset)
+  {
+    auto location = lines.locate(offset);
+    if(location.line != line || location.column != column)
+    {
+      std::cout << std::format("  offset {}: {}:{} vs {}:{}\n",
+                               offset,
+                               location.line,
+                               location.column,
+                               line,
+                               column);
+      return false;
+    }
+    if(offset < source.size() && source[offset] == '\n')
+    {
+      ++line;
+      column = 1;
+    }
+    else
+    {
+      ++column;
+    }
+  }
+  return true;
+}
+
+bool
+check(const std::string &text)
+{
+  // 两个扫描器读同一块内存, 可以直接比较 lexeme 的地址
+  auto source = beacon_lox::Source::from_string(text);
+  beacon_lox::Scanner scanner{source};
+  beacon_lox::DfaScanner dfa_scanner{source};
+  if(same_tokens(scanner.scan_tokens(), dfa_scanner.scan_tokens()) &&
+     same_locations(source.view()))
+  {
+    return true;
+  }
+  std::cout << std::format("mismatch on input: [{}]\n", text);
+  return false;
+}
+
+// 从一组片段里随机拼接, 覆盖关键字, 数字边界, 注释, 多行字符串等情况
+std::string
+random_source(std::mt19937 &rng, std::size_t pieces)
+{
+  static const std::vector<std::string> fragments = {
+      "and",   "class", "else",   "false", "fun",    "for",  "if",
+      "nil",   "or",    "print",  "return", "super", "this", "true",
+      "var",   "while", "whale",  "classy", "_x1",   "r",    "orchid",
+      "0",     "12",    "3.25",   "7.",    ".5",     "1.2.3", "\"\"",
+      "\"ab\"", "\"a\nb\"", "// note\n", "//", "/",  "!",    "!=",
+      "=",     "==",    "<",      "<=",    ">",      ">=",   "(",
+      ")",     "{",     "}",      ",",     ".",      "-",    "+",
+      ";",     "*",     " ",      "\t",    "\r\n",   "\n",   "\"open",
+      // 非 ASCII 的标识符和字符串, 都不会产生错误输出
+      "\u00e9t\u00e9", "\u53d8\u91cf", "x\u0303", "\"\u00e9\""};
+  std::uniform_int_distribution<std::size_t> pick(0, fragments.size() - 1);
+  std::string out;
+  for(std::size_t i = 0; i < pieces; ++i)
+  {
+    out += fragments[pick(rng)];
+  }
+  return out;
+}
+
+template <typename Lexer>
+double
+throughput(const std::string &source, int rounds)
+{
+  auto begin = std::chrono::steady_clock::now();
+  std::size_t count = 0;
+  for(int i = 0; i < rounds; ++i)
+  {
+    Lexer lexer{source};
+    count += lexer.scan_tokens().size();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - begin;
+  if(count == 0)
+  {
+    return 0;
+  }
+  return static_cast<double>(source.size()) * rounds / elapsed.count() / 1e6;
+}
+
+int
+main(int /*argc*/, char ** /*argv*/)
+{
+  const std::vector<std::string> corpus = {
+      "",
+      "(1 + 2) * 3 - -4 >= 2 == !false",
+      "var answer = 42.5; // comment\nprint answer;",
+      "class Foo { fun bar() { return this.x; } }",
+      "\"multi\nline\nstring\" + 1",
+      "12.abc 3. .4 5.6.7",
+      "returned printer nilly",
+      "\"unterminated\n",
+      "a\r\nb\r\n// trailing",
+      "a @ b",
+      "var \u53d8\u91cf = \"\u00e9\u00e8\"; print \u53d8\u91cf;",
+      "na\u0303o \u00b7x x\u00b7 \u0663\u0664",
+      "\u20ac\u20ac\u20ac + \u2603",
+      "a \xff\xfe b \xc3 \"\xe2\x82\"",
+  };
+
+  int failures = 0;
+  for(const auto &source : corpus)
+  {
+    failures += check(source) ? 0 : 1;
+  }
+
+  std::mt19937 rng(20241018);
+  for(int i = 0; i < 20000; ++i)
+  {
+    failures += check(random_source(rng, 1 + i % 64)) ? 0 : 1;
+  }
+
+  if(failures != 0)
+  {
+    std::cout << std::format("{} mismatches\n", failures);
+    return 1;
+  }
+  std::cout << "differential test passed\n";
+
+  // 吞吐对比, 错误字符会刷屏, 这里的输入不包含它们
+  std::string big;
+  while(big.size() < (4U << 20))
+  {
+    big += "var total_42 = (alpha + 3.25) * beta - \"text\";"
+           " // comment\nif(total_42 >= 10) print total_42;\n";
+  }
+  std::cout << std::format("Scanner    ({}): {:.1f} MB/s\n",
+                           beacon_lox::simd::kernel_name(),
+                           throughput<beacon_lox::Scanner>(big, 3));
+  std::cout << std::format("DfaScanner        : {:.1f} MB/s\n",
+                           throughput<beacon_lox::DfaScanner>(big, 3));
+
+  // 全是 ASCII 时 UTF-8 校验应该接近内存带宽
+  auto begin = std::chrono::steady_clock::now();
+  std::size_t valid = 0;
+  for(int i = 0; i < 20; ++i)
+  {
+    valid += beacon_lox::simd::validate_utf8(big.data(),
+                                             big.data() + big.size());
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - begin;
+  std::cout << std::format("validate_utf8     : {:.1f} MB/s\n",
+                           static_cast<double>(valid) / elapsed.count() / 1e6);
+  return 0;
+}
@@ -0,0 +1,128 @@
+#include "parallel_scanner.hh"
+#include "scanner.hh"
+
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 并行扫描必须和 Scanner 的结果完全一致
+// 用很小的分段强制切出大量段边界, 覆盖跨段的字符串和注释
+
+
+bool
+same_tokens(const std::vector<beacon_lox::Token> &lhs,
+            const std::vector<beacon_lox::Token> &rhs)
+{
+  if(lhs.size() != rhs.size())
+  {
+    std::cout << std::format("  size {} vs {}\n", lhs.size(), rhs.size());
+    return false;
+  }
+  for(std::size_t i = 0; i < lhs.size(); ++i)
+  {
+    if(lhs[i].get_type() != rhs[i].get_type() ||
+       lhs[i].get_lexeme().data() != rhs[i].get_lexeme().data() ||
+       lhs[i].get_lexeme().size() != rhs[i].get_lexeme().size() ||
+       lhs[i].get_literal() != rhs[i].get_literal() ||
+       lhs[i].get_symbol() != rhs[i].get_symbol())
+    {
+      std::cout << std::format("  token {}: {} '{}' vs {} '{}'\n",
+                               i,
+                               lhs[i].get_type(),
+                               lhs[i].get_lexeme(),
+                               rhs[i].get_type(),
+                               rhs[i].get_lexeme());
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string
+random_source(std::mt19937 &rng, std::size_t pieces)
+{
+  static const std::vector<std::string> fragments = {
+      "var",    "x",    "print", "12",    "3.5",       "\"s\"",
+      "\"a\nb\"", "\"\n\n\"", "\"",  "// c\n", "// \"q\n", "\n",
+      "\n\n",   " ",    "(",     ")",     "==",        "!",
+      "+",      ";",    "\t",    "r",     "\"x\n// y\n\""};
+  std::uniform_int_distribution<std::size_t> pick(0, fragments.size() - 1);
+  std::string out;
+  for(std::size_t i = 0; i < pieces; ++i)
+  {
+    out += fragments[pick(rng)];
+  }
+  return out;
+}
+
+int
+main(int /*argc*/, char ** /*argv*/)
+{
+  std::mt19937 rng(7);
+  int failures = 0;
+  for(int i = 0; i < 5000; ++i)
+  {
+    auto source = random_source(rng, 1 + i % 200);
+    // 驻留顺序相同, 两边各用一个表分配出的编号也应该相同
+    beacon_lox::SymbolTable symbols;
+    beacon_lox::Scanner scanner{std::string_view(source)};
+    scanner.set_symbols(symbols);
+    const auto &expect = scanner.scan_tokens();
+    for(unsigned threads : {2U, 3U, 8U})
+    {
+      beacon_lox::SymbolTable parallel_symbols;
+      beacon_lox::ParallelScanner parallel(source, threads, 1);
+      parallel.set_symbols(parallel_symbols);
+      if(!same_tokens(expect, parallel.scan_tokens()))
+      {
+        std::cout << std::format("mismatch ({} threads) on input: [{}]\n",
+                                 threads,
+                                 source);
+        ++failures;
+      }
+    }
+  }
+  if(failures != 0)
+  {
+    std::cout << std::format("{} mismatches\n", failures);
+    return 1;
+  }
+  std::cout << "parallel scan matches Scanner\n";
+
+  std::string big;
+  while(big.size() < (8U << 20))
+  {
+    big += "var total_42 = (alpha + 3.25) * beta - \"multi\nline\";"
+           " // comment\nif(total_42 >= 10) print total_42;\n";
+  }
+  auto time = [&big](auto &&scan)
+  {
+    auto begin = std::chrono::steady_clock::now();
+    auto count = scan(big);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - begin;
+    return std::pair{count, elapsed.count()};
+  };
+  auto [seq_count, seq_time] = time(
+      [](const std::string &text)
+      {
+        beacon_lox::Scanner scanner{std::string_view(text)};
+        return scanner.scan_tokens().size();
+      });
+  auto [par_count, par_time] = time(
+      [](const std::string &text)
+      {
+        beacon_lox::ParallelScanner scanner{text};
+        return scanner.scan_tokens().size();
+      });
+  std::cout << std::format("Scanner: {:.3f}s, ParallelScanner ({} threads): "
+                           "{:.3f}s\n",
+                           seq_time,
+                           std::thread::hardware_concurrency(),
+                           par_time);
+  return seq_count == par_count ? 0 : 1;
+}
@@ -0,0 +1,147 @@
+#include "ast.hh"
+#include "compilation_unit.hh"
+#include "error.hh"
+
+#include <format>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+// 解析的结果必须是预期的树: 优先级和结合性, 出错之后的恢复, 哈希共享前后的树相同
+// 输入都在这里生成, 不依赖外部文件
+
+
+std::string
+print(const beacon_lox::Expr &expr)
+{
+  return beacon_lox::ExprPrinter().visit(expr);
+}
+
+// 动态的 ExprVisitor, 必须和静态分派的 ExprPrinter 相同
+std::string
+visit(const beacon_lox::Expr &expr)
+{
+  beacon_lox::ExprVisitor visitor;
+  return std::any_cast<std::string>(
+      std::visit([&visitor](const auto &value) -> std::any
+                 { return value->accept(&visitor); },
+                 expr));
+}
+
+int
+main(int /*argc*/, char ** /*argv*/)
+{
+  int failed = 0;
+
+  // 优先级和结合性, 期望的结果来自原来的递归下降解析
+  struct Case
+  {
+    std::string_view source;
+    std::string_view tree;
+  };
+  const Case cases[] = {
+      {"1 + 2 * 3", "(PLUS + (1.0) (STAR * (2.0) (3.0)))"},
+      {"1 - 2 - 3", "(MINUS - (MINUS - (1.0) (2.0)) (3.0))"},
+      {"1 / 2 / 3 * 4", "(STAR * (SLASH / (SLASH / (1.0) (2.0)) (3.0)) (4.0))"},
+      {"-1 + 2", "(PLUS + (MINUS - (1.0)) (2.0))"},
+      {"1 == 2 != 3 == 4",
+       "(EQUAL_EQUAL == (BANG_EQUAL != (EQUAL_EQUAL == (1.0) (2.0)) (3.0)) "
+       "(4.0))"},
+      {"1 + 2 < 3 * 4 == !nil",
+       "(EQUAL_EQUAL == (LESS < (PLUS + (1.0) (2.0)) (STAR * (3.0) (4.0))) "
+       "(BANS ! (null)))"},
+      {"-(1 - 2) * -3 / (4)",
+       "(SLASH / (STAR * (MINUS - (grouping (MINUS - (1.0) (2.0)))) "
+       "(MINUS - (3.0))) (grouping (4.0)))"},
+      {"1 <= 2 > 3 < 4 >= 5",
+       "(GREATER_EQUAL >= (LESS < (GREATER > (LESS_EQUAL <= (1.0) (2.0)) "
+       "(3.0)) (4.0)) (5.0))"},
+  };
+  for(const auto &c : cases)
+  {
+    auto unit = beacon_lox::CompilationUnit::from_string(c.source);
+    if(!unit.parse() || unit.exprs().size() != 1)
+    {
+      std::cout << std::format("failed to parse: {}\n", c.source);
+      ++failed;
+      continue;
+    }
+    const auto &expr = unit.exprs().front();
+    if(print(expr) != c.tree || visit(expr) != c.tree)
+    {
+      std::cout << std::format("mismatch: {}\n  got  {}\n  visitor {}\n"
+                               "  want {}\n",
+                               c.source,
+                               print(expr),
+                               visit(expr),
+                               c.tree);
+      ++failed;
+    }
+  }
+
+  // 不抛异常的解析: 一次收集所有的错误, 每个错误之后从下一条语句继续
+  auto broken =
+      beacon_lox::CompilationUnit::from_string("1 + ;\n2 * (3;\n-;\n4 5;\n6");
+  beacon_lox::Error sink;
+  if(broken.parse())
+  {
+    std::cout << "broken source parsed without errors\n";
+    ++failed;
+  }
+  broken.report(sink);
+  std::string errors;
+  for(const auto &err : sink.errors())
+  {
+    errors += err;
+  }
+  const std::string_view expect_errors =
+      "[line 1, column 5] Error at ';': Expect expression.\n"
+      "[line 2, column 7] Error at ';': ( not match!\n"
+      "[line 3, column 2] Error at ';': Expect expression.\n"
+      "[line 4, column 3] Error at '5': Expect ';' after expression.\n";
+  if(broken.exprs().size() != 1 || print(broken.exprs().front()) != "(6.0)" ||
+     errors != expect_errors)
+  {
+    std::cout << std::format("parse_all: {} exprs, errors:\n{}",
+                             broken.exprs().size(),
+                             errors);
+    ++failed;
+  }
+
+  // 哈希共享: 重复的子表达式只分配一次, 打印出来的树必须和不共享时相同
+  std::string repeated = "1";
+  for(int i = 0; i < 3000; ++i)
+  {
+    repeated +=
+        i % 3 == 0 ? " + (2 * -3)" : (i % 3 == 1 ? " - 4 / 5" : " == !true");
+  }
+  repeated += ";\n(2 * -3) + (2 * -3)";
+  auto plain = beacon_lox::CompilationUnit::from_string(repeated);
+  plain.parse();
+  auto shared = beacon_lox::CompilationUnit::from_string(repeated);
+  shared.enable_hash_consing();
+  shared.parse();
+  if(plain.exprs().size() != 2 || shared.exprs().size() != 2)
+  {
+    std::cout << "repeated source failed to parse\n";
+    return 1;
+  }
+  for(std::size_t i = 0; i < plain.exprs().size(); ++i)
+  {
+    if(print(plain.exprs()[i]) != print(shared.exprs()[i]))
+    {
+      std::cout << std::format("hash-consed tree {} differs\n", i);
+      ++failed;
+    }
+  }
+  if(shared.ast_bytes() >= plain.ast_bytes())
+  {
+    std::cout << std::format("hash-consing did not shrink the ast: {} vs {}\n",
+                             shared.ast_bytes(),
+                             plain.ast_bytes());
+    ++failed;
+  }
+
+  std::cout << (failed == 0 ? "all passed\n" : "FAILED\n");
+  return failed == 0 ? 0 : 1;
+}
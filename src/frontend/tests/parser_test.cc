@@ -1,41 +1,37 @@
-#include <sstream>
-#include <fstream>
-
+#include "ast_dump.hh"
+#include "error.hh"
+#include "flat_ast.hh"
+#include "line_index.hh"
 #include "parser.hh"
 #include "scanner.hh"
+#include "source.hh"
 
+#include <chrono>
+#include <iterator>
 
 
+// token 由 Scanner::take_tokens 移交出来, 解析时只借用, 不拷贝
+using SpanParser = beacon_lox::BasicParser<beacon_lox::TokenSpanCursor>;
 
 
 int
 main(int /*argc*/, char ** /*argv*/)
 {
   // std::string_view path{argv[1]};
-  std::stringstream ss;
-  std::fstream file("/workspace/crafting_interpreters/data/bea.lox");
-  if(!file.is_open())
+  beacon_lox::Source source("/workspace/crafting_interpreters/data/bea.lox");
+  if(!source.is_open())
   {
     return 65;
   }
-  ss << file.rdbuf();
-  beacon_lox::Scanner scanner{ss.str()};
-  auto tokens = scanner.scan_tokens();
+  beacon_lox::Scanner scanner{source};
+  auto tokens = scanner.take_tokens();
 
-  for(const auto token : tokens)
-  {
-    // std::cout << "format:" << token.get_lexeme() << "\n";
-    std::cout << std::format("{} {} {}\n",
-                             token.get_type(),
-                             token.get_lexeme(),
-                             token.get_literal());
-  }
+  beacon_lox::dump_tokens(tokens, std::ostreambuf_iterator<char>(std::cout));
 
-  
-  beacon_lox::Parser par(tokens);
+  SpanParser par(tokens);
   try
   {
-    auto expr = par.parse();
+    auto result = par.parse();
     std::cout << "-------------------------\n";
 
     beacon_lox::ExprVisitor visitor;
@@ -44,13 +40,143 @@ main(int /*argc*/, char ** /*argv*/)
                              std::any_cast<std::string>(std::visit(
                                  [&visitor](const auto &value) -> std::any
                                  { return value->accept(&visitor); },
-                                 expr)));
+                                 result.expr)));
+  }
+  catch(const std::exception &e)
+  {
+    std::cout << "exception: " << e.what() << "\n";
+  }
+
+  // 流式解析: 不生成整个 token vector, 边扫描边解析
+  beacon_lox::Scanner stream_scanner{source};
+  beacon_lox::BasicParser<beacon_lox::TokenStreamCursor<>> stream_par(
+      stream_scanner);
+  try
+  {
+    auto result = stream_par.parse();
+    beacon_lox::ExprVisitor visitor;
+
+    std::cout << std::format("stream exp: {}\n",
+                             std::any_cast<std::string>(std::visit(
+                                 [&visitor](const auto &value) -> std::any
+                                 { return value->accept(&visitor); },
+                                 result.expr)));
   }
   catch(const std::exception &e)
   {
     std::cout << "exception: " << e.what() << "\n";
   }
 
+  // 列式 token 存储
+  beacon_lox::Scanner buffer_scanner{source};
+  auto buffer = beacon_lox::TokenBuffer::scan(buffer_scanner);
+  std::cout << std::format("token memory: vector {} bytes, buffer {} bytes\n",
+                           tokens.size() * sizeof(beacon_lox::Token),
+                           buffer.memory_bytes());
+  beacon_lox::BasicParser<beacon_lox::TokenBufferCursor> buffer_par(buffer);
+  try
+  {
+    auto result = buffer_par.parse();
+    beacon_lox::ExprVisitor visitor;
+
+    std::cout << std::format("buffer exp: {}\n",
+                             std::any_cast<std::string>(std::visit(
+                                 [&visitor](const auto &value) -> std::any
+                                 { return value->accept(&visitor); },
+                                 result.expr)));
+  }
+  catch(const std::exception &e)
+  {
+    std::cout << "exception: " << e.what() << "\n";
+  }
+
+
+  // 大量出错的小文件: 抛异常在第一个错误处停下, parse_all 不抛异常并且继续
+  // 解析的结果由 parser_cases 检查, 这里只看时间
+  std::string_view broken = "1 + ;\n2 * (3;\n-;\n4 5;\n6";
+  constexpr int kFiles = 20000;
+  std::vector<std::vector<beacon_lox::Token>> files;
+  for(int i = 0; i < kFiles; ++i)
+  {
+    beacon_lox::Scanner file_scanner{broken};
+    files.push_back(file_scanner.take_tokens());
+  }
+  std::size_t thrown = 0;
+  auto start = std::chrono::steady_clock::now();
+  for(const auto &file : files)
+  {
+    try
+    {
+      SpanParser(file).parse();
+    }
+    catch(const std::exception &)
+    {
+      ++thrown;
+    }
+  }
+  std::chrono::duration<double> throw_time =
+      std::chrono::steady_clock::now() - start;
+  std::size_t collected = 0;
+  start = std::chrono::steady_clock::now();
+  for(const auto &file : files)
+  {
+    collected += SpanParser(file).parse_all().diagnostics.size();
+  }
+  std::chrono::duration<double> batch_time =
+      std::chrono::steady_clock::now() - start;
+  std::cout << std::format(
+      "{} files: parse() {} errors {:.3f}s, parse_all() {} errors {:.3f}s\n",
+      kFiles,
+      thrown,
+      throw_time.count(),
+      collected,
+      batch_time.count());
+
+  // 很长的生成表达式: 解析和释放的时间主要花在节点分配上
+  std::string big = "1";
+  for(int i = 0; i < 200000; ++i)
+  {
+    big += i % 3 == 0 ? " + (2 * -3)" : (i % 3 == 1 ? " - 4 / 5" : " == !true");
+  }
+  // 只扫描一次, 下面几次解析都借用这些 token
+  beacon_lox::Scanner big_scanner{std::string_view(big)};
+  const auto big_tokens = big_scanner.take_tokens();
+  SpanParser big_par(big_tokens);
+  auto begin = std::chrono::steady_clock::now();
+  std::size_t arena_bytes = 0;
+  {
+    auto result = big_par.parse();
+    arena_bytes = result.arena.bytes_used();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - begin;
+  std::cout << std::format("parse + free {} bytes of nodes: {:.3f}s\n",
+                           arena_bytes,
+                           elapsed.count());
+
+  // 同样的树转成扁平的后序数组, 每个节点 16 字节
+  auto big_result = SpanParser(big_tokens).parse();
+  begin = std::chrono::steady_clock::now();
+  auto flat = beacon_lox::FlatAst::from_tree(big_result.expr, big);
+  elapsed = std::chrono::steady_clock::now() - begin;
+  std::cout << std::format("flatten {} nodes into {} bytes: {:.3f}s\n",
+                           flat.size(),
+                           flat.memory_bytes(),
+                           elapsed.count());
+
+  // 哈希共享: 重复的子表达式只分配一次
+  auto plain = SpanParser(big_tokens).parse();
+  SpanParser shared_par(big_tokens);
+  shared_par.enable_hash_consing();
+  begin = std::chrono::steady_clock::now();
+  auto shared = shared_par.parse();
+  elapsed = std::chrono::steady_clock::now() - begin;
+  std::cout << std::format(
+      "hash-consing: {} bytes -> {} bytes, {} nodes reused, {:.3f}s\n",
+      plain.arena.bytes_used(),
+      shared.arena.bytes_used(),
+      shared_par.shared_nodes(),
+      elapsed.count());
 
   return 0;
 }
\ No newline at end of file
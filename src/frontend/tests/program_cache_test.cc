@@ -0,0 +1,311 @@
+#include "compilation_unit.hh"
+#include "flat_ast.hh"
+#include "program_cache.hh"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 存进缓存再读出来的 token 和扁平 AST 必须和直接扫描, 解析的结果一致
+// 源码变了, 或者缓存文件被改坏了, 都不能命中
+
+
+std::string
+random_program(std::mt19937 &rng, std::size_t exprs)
+{
+  static const std::vector<std::string> atoms = {
+      "1", "2.5", "nil", "true", "false", "\"s\"", "\"long string\"", "\"\""};
+  static const std::vector<std::string> ops = {
+      " + ", " - ", " * ", " / ", " == ", " != ", " < ", " >= "};
+  std::uniform_int_distribution<std::size_t> atom(0, atoms.size() - 1);
+  std::uniform_int_distribution<std::size_t> op(0, ops.size() - 1);
+  std::uniform_int_distribution<int> len(1, 12);
+  std::uniform_int_distribution<int> coin(0, 3);
+  std::string text;
+  for(std::size_t i = 0; i < exprs; ++i)
+  {
+    int n = len(rng);
+    for(int j = 0; j < n; ++j)
+    {
+      if(j > 0)
+      {
+        text += ops[op(rng)];
+      }
+      switch(coin(rng))
+      {
+        case 0:
+          text += "-" + atoms[atom(rng)];
+          break;
+        case 1:
+          text += "(" + atoms[atom(rng)] + ops[op(rng)] + atoms[atom(rng)] + ")";
+          break;
+        default:
+          text += atoms[atom(rng)];
+          break;
+      }
+    }
+    text += ";\n";
+  }
+  return text;
+}
+
+bool
+same_program(const beacon_lox::CompilationUnit &unit,
+              const beacon_lox::FlatAst &flat,
+              const beacon_lox::CachedProgram &cached)
+{
+  auto tokens = unit.tokens();
+  if(tokens.size() != cached.token_count())
+  {
+    std::cout << std::format("  {} tokens vs {}\n",
+                             tokens.size(),
+                             cached.token_count());
+    return false;
+  }
+  for(std::size_t i = 0; i < tokens.size(); ++i)
+  {
+    if(tokens[i].get_type() != cached.token_type(i) ||
+       tokens[i].get_lexeme().data() != cached.lexeme(i).data() ||
+       tokens[i].get_lexeme().size() != cached.lexeme(i).size())
+    {
+      std::cout << std::format("  token {} differs\n", i);
+      return false;
+    }
+  }
+
+  const auto &ast = cached.ast();
+  if(flat.size() != ast.size() || flat.roots().size() != ast.roots().size())
+  {
+    std::cout << std::format("  {} nodes vs {}\n", flat.size(), ast.size());
+    return false;
+  }
+  for(std::size_t i = 0; i < flat.roots().size(); ++i)
+  {
+    if(flat.roots()[i] != ast.roots()[i])
+    {
+      return false;
+    }
+  }
+  for(std::size_t i = 0; i < flat.size(); ++i)
+  {
+    const auto &a = flat.nodes()[i];
+    const auto &b = ast.nodes()[i];
+    bool same = a.kind == b.kind && a.op == b.op && a.offset == b.offset;
+    switch(a.kind)
+    {
+      case beacon_lox::FlatKind::NUMBER:
+        same = same && flat.number(a) == ast.number(b);
+        break;
+      case beacon_lox::FlatKind::STRING:
+        // 驻留编号不进缓存
+        same = same && flat.string(a) == ast.string(b) &&
+               b.rhs == beacon_lox::kNoSymbol;
+        break;
+      default:
+        same = same && a.lhs == b.lhs && a.rhs == b.rhs;
+        break;
+    }
+    if(!same)
+    {
+      std::cout << std::format("  node {} differs\n", i);
+      return false;
+    }
+  }
+  return true;
+}
+
+// 用 node 覆盖缓存文件里的第 index 个节点
+void
+overwrite_node(const std::string &path,
+               std::size_t index,
+               const beacon_lox::FlatNode &node)
+{
+  beacon_lox::CacheHeader header;
+  std::ifstream in(path, std::ios::binary);
+  in.read(reinterpret_cast<char *>(&header), sizeof(header));
+  in.close();
+  const auto offset = header.sections[beacon_lox::AST_NODES].offset +
+                      index * sizeof(beacon_lox::FlatNode);
+  std::fstream out(path, std::ios::binary | std::ios::in | std::ios::out);
+  out.seekp(static_cast<std::streamoff>(offset));
+  out.write(reinterpret_cast<const char *>(&node), sizeof(node));
+}
+
+int
+main()
+{
+  const auto dir = std::filesystem::temp_directory_path() /
+                   std::format("beacon_lox_cache_test_{}", ::getpid());
+  beacon_lox::ProgramCache cache(dir.string());
+  std::mt19937 rng(20241018);
+  int failed = 0;
+
+  for(int round = 0; round < 200; ++round)
+  {
+    auto unit =
+        beacon_lox::CompilationUnit::from_string(random_program(rng, 1 + round % 7));
+    if(cache.load(unit.source()))
+    {
+      std::cout << std::format("round {}: hit before store\n", round);
+      ++failed;
+      continue;
+    }
+    unit.parse();
+    auto flat = beacon_lox::FlatAst::from_trees(unit.exprs(), unit.source());
+    if(!cache.store(unit.source(), unit.tokens(), flat))
+    {
+      std::cout << std::format("round {}: store failed\n", round);
+      ++failed;
+      continue;
+    }
+    auto cached = cache.load(unit.source());
+    if(!cached || !same_program(unit, flat, *cached))
+    {
+      std::cout << std::format("round {}: round trip differs\n", round);
+      ++failed;
+    }
+  }
+
+  // 同样长度, 只改了一个字节的源码不能命中
+  std::string text = random_program(rng, 3);
+  {
+    auto unit = beacon_lox::CompilationUnit::from_string(text);
+    unit.parse();
+    cache.store(unit.source(),
+                unit.tokens(),
+                beacon_lox::FlatAst::from_trees(unit.exprs(), unit.source()));
+  }
+  std::string changed = text;
+  changed[0] = changed[0] == '1' ? '2' : '1';
+  if(cache.load(changed))
+  {
+    std::cout << "changed source hit the cache\n";
+    ++failed;
+  }
+
+  // 把缓存文件截断, 或者改掉节点里的下标, 都要被拒绝
+  const std::string path = cache.path_for(text);
+  const auto size = std::filesystem::file_size(path);
+  std::filesystem::resize_file(path, size - 1);
+  if(cache.load(text))
+  {
+    std::cout << "truncated cache file accepted\n";
+    ++failed;
+  }
+  {
+    auto unit = beacon_lox::CompilationUnit::from_string(text);
+    unit.parse();
+    auto flat = beacon_lox::FlatAst::from_trees(unit.exprs(), unit.source());
+    cache.store(unit.source(), unit.tokens(), flat);
+    // 最后一个节点一定是根节点, 把它的左子节点指向自己
+    beacon_lox::FlatNode node = flat.nodes().back();
+    node.kind = beacon_lox::FlatKind::GROUPING;
+    node.lhs = static_cast<std::uint32_t>(flat.size() - 1);
+    overwrite_node(path, flat.size() - 1, node);
+  }
+  if(cache.load(text))
+  {
+    std::cout << "corrupted node accepted\n";
+    ++failed;
+  }
+  // 字符串节点带上驻留编号: 求值时会拿它去查驻留表
+  const std::string strings = "\"a\" + \"b\";";
+  {
+    auto unit = beacon_lox::CompilationUnit::from_string(strings);
+    unit.parse();
+    auto flat = beacon_lox::FlatAst::from_trees(unit.exprs(), unit.source());
+    cache.store(unit.source(), unit.tokens(), flat);
+    if(!cache.load(strings))
+    {
+      std::cout << "string program missed the cache\n";
+      ++failed;
+    }
+    beacon_lox::FlatNode node = flat.nodes().front();
+    node.rhs = 1000000;
+    overwrite_node(cache.path_for(strings), 0, node);
+  }
+  if(cache.load(strings))
+  {
+    std::cout << "string node with a symbol id accepted\n";
+    ++failed;
+  }
+
+  // 同一进程的几个线程同时存同一份源码, 同时有线程在读:
+  // 每次存都要成功, 读到的总是完整的文件
+  {
+    auto unit =
+        beacon_lox::CompilationUnit::from_string(random_program(rng, 2000));
+    unit.parse();
+    auto flat = beacon_lox::FlatAst::from_trees(unit.exprs(), unit.source());
+    std::atomic<int> store_failed{0};
+    std::atomic<int> load_failed{0};
+    std::vector<std::thread> writers;
+    for(int t = 0; t < 4; ++t)
+    {
+      writers.emplace_back(
+          [&]
+          {
+            for(int i = 0; i < 20; ++i)
+            {
+              if(!cache.store(unit.source(), unit.tokens(), flat))
+              {
+                ++store_failed;
+              }
+              auto cached = cache.load(unit.source());
+              if(cached && !same_program(unit, flat, *cached))
+              {
+                ++load_failed;
+              }
+            }
+          });
+    }
+    for(auto &writer : writers)
+    {
+      writer.join();
+    }
+    if(store_failed != 0 || load_failed != 0)
+    {
+      std::cout << std::format("concurrent stores: {} failed, {} bad loads\n",
+                               store_failed.load(),
+                               load_failed.load());
+      ++failed;
+    }
+  }
+
+  // 启动时间: 扫描 + 解析, 和直接映射缓存比较
+  std::string big = random_program(rng, 20000);
+  auto begin = std::chrono::steady_clock::now();
+  auto unit = beacon_lox::CompilationUnit::from_string(big);
+  unit.parse();
+  auto flat = beacon_lox::FlatAst::from_trees(unit.exprs(), unit.source());
+  std::chrono::duration<double> parse_time =
+      std::chrono::steady_clock::now() - begin;
+  cache.store(unit.source(), unit.tokens(), flat);
+  begin = std::chrono::steady_clock::now();
+  auto cached = cache.load(unit.source());
+  std::chrono::duration<double> load_time =
+      std::chrono::steady_clock::now() - begin;
+  if(!cached || !same_program(unit, flat, *cached))
+  {
+    std::cout << "big program round trip differs\n";
+    ++failed;
+  }
+  std::cout << std::format("{} bytes, {} nodes: parse {:.4f}s, cache {:.4f}s\n",
+                           big.size(),
+                           flat.size(),
+                           parse_time.count(),
+                           load_time.count());
+
+  std::filesystem::remove_all(dir);
+  std::cout << (failed == 0 ? "all passed\n" : "FAILED\n");
+  return failed == 0 ? 0 : 1;
+}
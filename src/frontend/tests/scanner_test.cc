@@ -1,6 +1,6 @@
+#include "line_index.hh"
 #include "scanner.hh"
-#include <sstream>
-#include <fstream>
+#include "source.hh"
 #include <iostream>
 #include <format>
 
@@ -8,23 +8,26 @@ int
 main(int /*argc*/, char ** /*argv*/)
 {
   // std::string_view path{argv[1]};
-  std::stringstream ss;
-  std::fstream file("/workspace/crafting_interpreters/data/bea.lox");
-  if(!file.is_open())
+  beacon_lox::Source source("/workspace/crafting_interpreters/data/bea.lox");
+  if(!source.is_open())
   {
     return 65;
   }
-  ss << file.rdbuf();
-  beacon_lox::Scanner scanner{ss.str()};
-  auto tokens = scanner.scan_tokens();
+  beacon_lox::Scanner scanner{source};
+  const auto &tokens = scanner.scan_tokens();
+  // 行号和列号只在输出时才换算
+  beacon_lox::LineIndex lines(source.view());
 
   for(const auto token : tokens)
   {
     // std::cout << "format:" << token.get_lexeme() << "\n";
-    std::cout << std::format("{} {} {}\n",
+    auto location = lines.locate(token);
+    std::cout << std::format("{} {} {} [{}:{}]\n",
                              token.get_type(),
                              token.get_lexeme(),
-                             token.get_literal());
+                             token.get_literal(),
+                             location.line,
+                             location.column);
   }
   return 0;
 }
\ No newline at end of file
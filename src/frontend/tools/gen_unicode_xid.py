@@ -0,0 +1,43 @@
+#!/usr/bin/env python3
+# 生成 src/unicode_xid.inc: 非 ASCII 部分的 XID_Start / XID_Continue 区间表
+# CPython 的 str.isidentifier() 就是按 UAX #31 的 XID 属性判断的
+#   python3 tools/gen_unicode_xid.py > src/unicode_xid.inc
+import sys
+import unicodedata
+
+
+def ranges(pred):
+    out = []
+    start = None
+    for cp in range(0x80, 0x110000):
+        if pred(cp):
+            if start is None:
+                start = cp
+        elif start is not None:
+            out.append((start, cp - 1))
+            start = None
+    if start is not None:
+        out.append((start, 0x10FFFF))
+    return out
+
+
+def xid_start(cp):
+    return chr(cp).isidentifier()
+
+
+def xid_continue(cp):
+    return ("a" + chr(cp)).isidentifier()
+
+
+def emit(name, table):
+    print(f"constexpr Range {name}[] = {{")
+    for lo, hi in table:
+        print(f"    {{0x{lo:04X}, 0x{hi:04X}}},")
+    print("};")
+    print()
+
+
+print(f"// 由 tools/gen_unicode_xid.py 生成, Unicode {unicodedata.unidata_version}, 不要手动修改")
+print()
+emit("kXidStart", ranges(xid_start))
+emit("kXidContinue", ranges(xid_continue))
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "frontend/include/arena.hh"
+#include "frontend/include/ast.hh"
+#include "frontend/include/error.hh"
+#include "frontend/include/line_index.hh"
+#include "frontend/include/symbol_table.hh"
+#include "interpreter/include/interpreter.hh"
+#include "interpreter/include/value.hh"
+
+namespace beacon_lox
+{
+// 解析之后, 求值之前的优化: 操作数都是字面量的运算在这里就算好, 换成一个 LiteralExpr
+// 运算规则直接借用 Interpreter, 所以折叠前后的结果一定相同
+// 运行时会出错的运算(比如 -"a", 1 + "a") 保持原样, 错误和它的位置留到求值时再报告
+// 括号只影响解析, 求值时什么都不做, 所以 GroupingExpr 总是去掉
+// 新节点分配在 arena 里(应该是解析时用的那个), 拼接出的字符串驻留在 symbols 里
+// 哈希共享的节点按地址记住折叠的结果, 每个节点只折叠一次, 同一个 ConstantFolder 跨表达式也有效
+class ConstantFolder
+{
+public:
+  ConstantFolder(SymbolTable &symbols, Arena &arena)
+    : symbols_(&symbols)
+    , arena_(&arena)
+    , lines_(std::string_view{})
+    , eval_(symbols, lines_)
+  {}
+
+  // 原来的节点只会被修改子节点指针, 不会被释放, 返回新的根节点
+  Expr
+  fold(const Expr &root)
+  {
+    // 和 FlatAst 一样用显式的栈做后序遍历, 很深的左结合链也不会栈溢出
+    struct Frame
+    {
+      Expr expr;
+      bool expanded;
+    };
+    std::vector<Frame> stack{{root, false}};
+    std::vector<Expr> done;
+    while(!stack.empty())
+    {
+      Frame frame = stack.back();
+      stack.pop_back();
+      const void *node = shared_node(frame.expr);
+      if(!frame.expanded)
+      {
+        if(auto it = memo_.find(node); node != nullptr && it != memo_.end())
+        {
+          done.push_back(it->second);
+          continue;
+        }
+        stack.push_back({frame.expr, true});
+        if(auto *const *binary = std::get_if<BinaryExprPtr>(&frame.expr))
+        {
+          stack.push_back({(*binary)->right, false});
+          stack.push_back({(*binary)->left, false});
+        }
+        else if(auto *const *unary = std::get_if<UnaryExprPtr>(&frame.expr))
+        {
+          stack.push_back({(*unary)->expr, false});
+        }
+        else if(auto *const *group = std::get_if<GroupingExprPtr>(&frame.expr))
+        {
+          stack.push_back({(*group)->expr, false});
+        }
+        continue;
+      }
+      done.push_back(fold_node(frame.expr, done));
+      if(node != nullptr)
+      {
+        memo_.emplace(node, done.back());
+      }
+    }
+    return done.back();
+  }
+
+  // 被替换成字面量的运算个数
+  [[nodiscard]] std::size_t
+  folded() const
+  {
+    return folded_;
+  }
+
+private:
+  // 子节点都已经折叠过, 结果在 done 的栈顶
+  Expr
+  fold_node(const Expr &expr, std::vector<Expr> &done)
+  {
+    if(auto *const *binary = std::get_if<BinaryExprPtr>(&expr))
+    {
+      (*binary)->right = pop(done);
+      (*binary)->left = pop(done);
+      auto *left = std::get_if<LiteralExprPtr>(&(*binary)->left);
+      auto *right = std::get_if<LiteralExprPtr>(&(*binary)->right);
+      if(left == nullptr || right == nullptr)
+      {
+        return expr;
+      }
+      try
+      {
+        return make_literal(eval_.apply_binary((*binary)->op,
+                                               (*binary)->token,
+                                               eval_.evaluate(*left),
+                                               eval_.evaluate(*right)));
+      }
+      catch(const Error::RuntimeError &)
+      {
+        return expr;
+      }
+    }
+    if(auto *const *unary = std::get_if<UnaryExprPtr>(&expr))
+    {
+      (*unary)->expr = pop(done);
+      auto *operand = std::get_if<LiteralExprPtr>(&(*unary)->expr);
+      if(operand == nullptr)
+      {
+        return expr;
+      }
+      try
+      {
+        return make_literal(eval_.apply_unary((*unary)->op,
+                                              (*unary)->token,
+                                              eval_.evaluate(*operand)));
+      }
+      catch(const Error::RuntimeError &)
+      {
+        return expr;
+      }
+    }
+    if(std::holds_alternative<GroupingExprPtr>(expr))
+    {
+      return pop(done);
+    }
+    return expr;
+  }
+
+  Expr
+  make_literal(Value value)
+  {
+    ++folded_;
+    if(value.is_number())
+    {
+      return arena_->make<LiteralExpr>(value.as_number());
+    }
+    if(value.is_bool())
+    {
+      return arena_->make<LiteralExpr>(value.as_bool());
+    }
+    if(value.is_symbol())
+    {
+      // 驻留表里的字符串一直有效, 可以直接作为字面量
+      SymbolId id = value.as_symbol().id;
+      return arena_->make<LiteralExpr>(symbols_->name(id), id);
+    }
+    return arena_->make<LiteralExpr>(nullptr);
+  }
+
+  static Expr
+  pop(std::vector<Expr> &done)
+  {
+    Expr expr = done.back();
+    done.pop_back();
+    return expr;
+  }
+
+  SymbolTable *symbols_;
+  Arena *arena_;
+  // 折叠时的错误都被吞掉, 用不到真正的行首表
+  LineIndex lines_;
+  Interpreter eval_;
+  std::size_t folded_{0};
+  // 共享节点 -> 折叠后的节点
+  std::unordered_map<const void *, Expr> memo_;
+};
+} // namespace beacon_lox
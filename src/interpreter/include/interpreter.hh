@@ -1,19 +1,38 @@
 #pragma once
 
 #include <iostream>
+#include <unordered_map>
+#include <vector>
 
 #include "frontend/include/ast.hh"
 #include "frontend/include/error.hh"
+#include "frontend/include/flat_ast.hh"
+#include "frontend/include/line_index.hh"
+#include "frontend/include/symbol_table.hh"
+#include "interpreter/include/ir.hh"
+#include "interpreter/include/value.hh"
 
 namespace beacon_lox
 {
 
-class Interpreter : public Visitor
+// 运行时的值是 Value(见 value.hh), 字符串都驻留在 symbols 里, 值里只有编号
+// 树上的求值用 StaticVisitor 分派, 直接返回 Value; Visitor 接口返回装着 Value 的 std::any
+// 扫描时用的应该是同一个表, 字面量才能直接使用 token 上的编号
+// lines 是被解释的源码的行首表, 只在报告运行时错误时用到
+class Interpreter
+  : public Visitor
+  , public StaticVisitor<Interpreter, Value>
 {
 public:
+  explicit Interpreter(SymbolTable &symbols, const LineIndex &lines)
+    : symbols_(&symbols)
+    , lines_(&lines)
+  {}
+
   void
   interpret(const Expr &expr)
   {
+    clear_memo();
     try
     {
       auto value = evaluate(expr);
@@ -26,249 +45,427 @@ public:
     }
   }
 
+  // 动态的 Visitor 接口, 只用来兼容, 求值走下面的静态分派
   std::any
   literal_expr_visitor(LiteralExpr *literal) override
   {
-    // std::cout << "literal_expr_visitor::literal->literal type:" << literal->literal.index() << "\n";
-    // // 这样返回的话, 这里返回的是一个 variant 对象, 而非一个double 类型数值.
-    // !它被自动包装为 std::any 存储一个 std::variant 对象
-    // return literal->literal;
-    // // return 3.0;
+    return visit_literal(literal);
+  }
+  std::any
+  unary_expr_visitor(UnaryExpr *unary) override
+  {
+    return visit_unary(unary);
+  }
+  std::any
+  binary_expr_visitor(BinaryExpr *binary) override
+  {
+    return visit_binary(binary);
+  }
+  std::any
+  grouping_expr_visitor(GroupingExpr *grouping) override
+  {
+    return visit_grouping(grouping);
+  }
+
+  // 求值但不打印结果, 运行时错误以 Error::RuntimeError 抛出
+  Value
+  evaluate(const Expr &expr)
+  {
+    return visit(expr);
+  }
+
+  // 哈希共享的节点的值按地址缓存, 表达式没有副作用, 同一个节点的值总是相同的
+  // 缓存只对同一棵树有效, interpret 每次开始时会清空
+  // 直接调用 evaluate 求值不同的树之前要先调用 clear_memo
+  void
+  clear_memo()
+  {
+    memo_.clear();
+  }
+
+  // 扁平 AST 的求值: 节点是后序排列的, 从前往后扫一遍, 子节点的值一定已经算好
+  // 和树上求值的顺序相同, 报错的位置也相同
+  // 每个根节点的子树是连续的一段, 一段出错不影响后面的表达式
+  void
+  interpret(const FlatAst &ast)
+  {
+    std::vector<Value> values(ast.size());
+    std::size_t begin = 0;
+    for(std::uint32_t root : ast.roots())
+    {
+      try
+      {
+        auto value = evaluate(ast, begin, root + 1, values);
+        std::cout << "result: " << stringify(value) << "\n";
+      }
+      catch(const Error::RuntimeError &e)
+      {
+        runtime_error(e);
+      }
+      begin = root + 1;
+    }
+  }
+
+  // 返回最后一个根节点的值
+  Value
+  evaluate(const FlatAst &ast)
+  {
+    std::vector<Value> values(ast.size());
+    return evaluate(ast, 0, ast.size(), values);
+  }
+
+  // SSA 形式的求值: 指令已经按求值顺序排好, 从前往后执行一遍
+  void
+  interpret(const IrFunction &fn)
+  {
+    try
+    {
+      auto value = evaluate(fn);
+      std::cout << "result: " << stringify(value) << "\n";
+    }
+    catch(const Error::RuntimeError &e)
+    {
+      runtime_error(e);
+    }
+  }
+
+  Value
+  evaluate(const IrFunction &fn)
+  {
+    std::vector<Value> values(fn.insts.size());
+    for(std::size_t i = 0; i < fn.insts.size(); ++i)
+    {
+      const IrInst &inst = fn.insts[i];
+      if(inst.op == IrOp::CONST)
+      {
+        values[i] = inst.constant;
+      }
+      else if(is_unary(inst.op))
+      {
+        values[i] =
+            apply_unary(unary_op(inst.op), inst.token, values[inst.lhs]);
+      }
+      else
+      {
+        values[i] = apply_binary(binary_op(inst.op),
+                                 inst.token,
+                                 values[inst.lhs],
+                                 values[inst.rhs]);
+      }
+    }
+    return values[fn.result];
+  }
+
+  [[nodiscard]] bool
+  had_runtime_error() const
+  {
+    return had_runtime_error_;
+  }
+
+  [[nodiscard]] bool
+  had_error() const
+  {
+    return had_error_;
+  }
 
-    // std::cout << "literal_expr_visitor::literal->literal index:"
-    //           << literal->literal.index() << "\n";
+private:
+  friend class StaticVisitor<Interpreter, Value>;
 
-    // 使用 std::visit 提取并返回具体值
+  Value
+  visit_literal(const LiteralExpr *literal)
+  {
     return std::visit(
-        [](const auto &value) -> std::any
+        [this, literal](const auto &value) -> Value
         {
-          // 所有类型都可以直接包装到 std::any
-          return std::any{value};
+          using T = std::decay_t<decltype(value)>;
+          if constexpr(std::is_same_v<T, std::string_view>)
+          {
+            if(literal->symbol != kNoSymbol)
+            {
+              return Symbol{literal->symbol};
+            }
+            return Symbol{symbols_->intern(value)};
+          }
+          else
+          {
+            return value;
+          }
         },
         literal->literal);
   }
 
-  std::any
-  unary_expr_visitor(UnaryExpr *unary) override
+  Value
+  visit_unary(UnaryExpr *unary)
   {
-    auto value = evaluate(unary->expr);
-    switch(unary->op)
+    if(unary->numeric && unary->op == UnaryOp::MINUS)
+    {
+      return -evaluate(unary->expr).as_number();
+    }
+    if(unary->shared)
+    {
+      return memoized(unary,
+                      [&]
+                      {
+                        return apply_unary(unary->op,
+                                           unary->token,
+                                           evaluate(unary->expr));
+                      });
+    }
+    return apply_unary(unary->op, unary->token, evaluate(unary->expr));
+  }
+
+  Value
+  visit_binary(BinaryExpr *binary)
+  {
+    auto compute = [&]
+    {
+      auto left = evaluate(binary->left);
+      auto right = evaluate(binary->right);
+      if(binary->numeric)
+      {
+        return apply_number(binary->op, left.as_number(), right.as_number());
+      }
+      return apply_binary(binary->op, binary->token, left, right);
+    };
+    return binary->shared ? memoized(binary, compute) : compute();
+  }
+
+  Value
+  visit_grouping(const GroupingExpr *grouping)
+  {
+    return evaluate(grouping->expr);
+  }
+
+  // 出错时抛出异常, 不会留下缓存, 下次遇到同一个节点会在同样的位置再报一次
+  template <typename Compute>
+  Value
+  memoized(const void *node, Compute compute)
+  {
+    if(auto it = memo_.find(node); it != memo_.end())
+    {
+      return it->second;
+    }
+    auto value = compute();
+    memo_.emplace(node, value);
+    return value;
+  }
+
+  // 常量折叠直接用这里的运算规则, 折叠的结果和运行时求值完全一致
+  friend class ConstantFolder;
+  friend class ConstantPropagation;
+
+  // 求 [begin, end) 这一段节点的值, 子节点的值从 values 里取
+  Value
+  evaluate(const FlatAst &ast,
+           std::size_t begin,
+           std::size_t end,
+           std::vector<Value> &values)
+  {
+    const auto nodes = ast.nodes();
+    for(std::size_t i = begin; i < end; ++i)
+    {
+      const FlatNode &node = nodes[i];
+      switch(node.kind)
+      {
+        case FlatKind::NIL:
+          values[i] = nullptr;
+          break;
+        case FlatKind::FALSE:
+          values[i] = false;
+          break;
+        case FlatKind::TRUE:
+          values[i] = true;
+          break;
+        case FlatKind::NUMBER:
+          values[i] = ast.number(node);
+          break;
+        case FlatKind::STRING:
+          values[i] = Symbol{node.rhs != kNoSymbol
+                                 ? node.rhs
+                                 : symbols_->intern(ast.string(node))};
+          break;
+        case FlatKind::UNARY:
+          values[i] = apply_unary(static_cast<UnaryOp>(node.op),
+                                  flat_token(ast, node),
+                                  values[node.lhs]);
+          break;
+        case FlatKind::BINARY:
+          values[i] = apply_binary(static_cast<BinaryOp>(node.op),
+                                   flat_token(ast, node),
+                                   values[node.lhs],
+                                   values[node.rhs]);
+          break;
+        case FlatKind::GROUPING:
+          values[i] = values[node.lhs];
+          break;
+      }
+    }
+    return end == begin ? Value{} : values[end - 1];
+  }
+
+  Value
+  apply_unary(UnaryOp op, const Token &token, Value value)
+  {
+    switch(op)
     {
       case UnaryOp::MINUS:
-        try
-        {
-          check_number_operand(unary->token, value);
-          return -std::any_cast<double>(value);
-        }
-        catch(std::exception &e)
-        {
-          // std::cout << "value: " << std::any_cast<std::string>(value)
-          //           << "\n";
-          throw Error::RuntimeError(unary->token, "unary minus must be number");
-        }
+        check_number_operand(token, value, "unary minus must be number");
+        return -value.as_number();
       case UnaryOp::BANS:
         // 这里的关键点是, 在 lox 中除了 ture, 其它的都是 false
         return !is_true(value);
       default:
         // throw Error::RuntimeError(unary->token, "unkown unary operator");
         std::cout << "runtime error\n";
-        return "runtime error";
+        return nullptr;
     }
   }
-  std::any
-  binary_expr_visitor(BinaryExpr *binary) override
+  Value
+  apply_binary(BinaryOp op, const Token &token, Value left, Value right)
   {
-    auto left = evaluate(binary->left);
-    auto right = evaluate(binary->right);
-    switch(binary->op)
+    switch(op)
     {
       case BinaryOp::PLUS:
-        if(is_type<double>(left) && is_type<double>(right))
+        if(left.is_number() && right.is_number())
         {
-          return std::any_cast<double>(left) + std::any_cast<double>(right);
+          return left.as_number() + right.as_number();
         }
-        if(is_type<std::string>(left) && is_type<std::string>(right))
+        if(left.is_symbol() && right.is_symbol())
         {
-          return std::any_cast<std::string>(left) +
-                 std::any_cast<std::string>(right);
+          // 拼接的结果也要驻留, 之后的比较仍然只比较编号
+          std::string joined{symbols_->name(left.as_symbol().id)};
+          joined += symbols_->name(right.as_symbol().id);
+          return Symbol{symbols_->intern(joined)};
         }
-        throw Error::RuntimeError(binary->token, "oprand must be two strings!");
+        throw Error::RuntimeError(token, "oprand must be two strings!");
         break;
       case BinaryOp::BANG_EQUAL:
         return !is_equal(left, right);
       case BinaryOp::EQUAL_EQUAL:
         return is_equal(left, right);
+      default:
+        check_number_operand(token, left, right);
+        return apply_number(op, left.as_number(), right.as_number());
+    }
+  }
+
+  // 操作数已经证明是数字时的运算, 不检查类型, 也不会出错
+  static Value
+  apply_number(BinaryOp op, double left, double right)
+  {
+    switch(op)
+    {
+      case BinaryOp::PLUS:
+        return left + right;
       case BinaryOp::MINUS:
-        check_number_operand(binary->token, left, right);
-        return std::any_cast<double>(left) - std::any_cast<double>(right);
-      case BinaryOp::SLASH:
-        check_number_operand(binary->token, left, right);
-        return std::any_cast<double>(left) / std::any_cast<double>(right);
+        return left - right;
       case BinaryOp::STAR:
-        check_number_operand(binary->token, left, right);
-        return std::any_cast<double>(left) * std::any_cast<double>(right);
+        return left * right;
+      case BinaryOp::SLASH:
+        return left / right;
+      case BinaryOp::EQUAL_EQUAL:
+        return left == right;
+      case BinaryOp::BANG_EQUAL:
+        return left != right;
       case BinaryOp::GREATER:
-        check_number_operand(binary->token, left, right);
-        return std::any_cast<double>(left) > std::any_cast<double>(right);
+        return left > right;
       case BinaryOp::GREATER_EQUAL:
-        check_number_operand(binary->token, left, right);
-        return std::any_cast<double>(left) >= std::any_cast<double>(right);
+        return left >= right;
       case BinaryOp::LESS:
-        check_number_operand(binary->token, left, right);
-        return std::any_cast<double>(left) < std::any_cast<double>(right);
+        return left < right;
       case BinaryOp::LESS_EQUAL:
-        check_number_operand(binary->token, left, right);
-        return std::any_cast<double>(left) <= std::any_cast<double>(right);
-        break;
+        return left <= right;
     }
     return true;
   }
-  std::any
-  grouping_expr_visitor(GroupingExpr *grouping) override
-  {
-    return evaluate(grouping->expr);
-  }
-
-  [[nodiscard]] bool
-  had_runtime_error() const
-  {
-    return had_runtime_error_;
-  }
 
-  [[nodiscard]] bool
-  had_error() const
+  // 扁平节点不带 Token, 用运算符的偏移拼一个只用于定位的 token
+  static Token
+  flat_token(const FlatAst &ast, const FlatNode &node)
   {
-    return had_error_;
-  }
-
-private:
-  std::any
-  evaluate(const Expr &expr)
-  {
-    // 这里忘记了 variant 的 visit 访问方法, accept 并不是 variant 的, 而是里面的值的
-    // return expr.accept(this);
-    return std::visit([this](const auto &value) { return value->accept(this); },
-                      expr);
+    std::string_view at = node.offset == kNoOffset
+                              ? std::string_view{}
+                              : ast.source().substr(node.offset, 0);
+    return Token{static_cast<TokenType>(node.op), at, nullptr};
   }
 
   std::string
-  stringify(std::any any)
+  stringify(Value value)
   {
-    if(is_type<std::nullptr_t>(any))
+    if(value.is_nil())
     {
       return "nil";
     }
 
-    if(is_type<double>(any))
+    if(value.is_number())
     {
-      return std::to_string(std::any_cast<double>(any));
+      return std::to_string(value.as_number());
     }
 
-    if(is_type<bool>(any))
+    if(value.is_bool())
     {
-      return std::any_cast<bool>(any) ? "ture" : "false";
+      return value.as_bool() ? "ture" : "false";
     }
 
-    return std::any_cast<std::string>(any);
+    return std::string{symbols_->name(value.as_symbol().id)};
   }
 
-  // 除了 nullptr 或者 false, 其它任何的东西都是 true
-  bool
-  is_true(std::any value)
+  // 除了 nil 或者 false, 其它任何的东西都是 true
+  static bool
+  is_true(Value value)
   {
-    if(is_type<std::nullptr_t>(value))
+    if(value.is_nil())
     {
       return false;
     }
 
-    if(is_type<bool>(value))
+    if(value.is_bool())
     {
-      return std::any_cast<bool>(value);
+      return value.as_bool();
     }
 
     return true;
   }
 
-  // bool
-  // is_equal(const std::any &left, const std::any &right)
-  // {
-  //   if(is_type<std::nullptr_t>(left) && is_type<std::nullptr_t>(right))
-  //   {
-  //     return true;
-  //   }
-  //   if(is_type<std::nullptr_t>(left))
-  //   {
-  //     return false;
-  //   }
-  //   return left == right;
-  // }
-
-  bool
-  is_equal(const std::any &left, const std::any &right)
+  static bool
+  is_equal(Value left, Value right)
   {
-    // 1. 两个都是空值（std::nullptr_t）
-    if(is_type<std::nullptr_t>(left) && is_type<std::nullptr_t>(right))
+    // 1. 两个都是 nil
+    if(left.is_nil() && right.is_nil())
     {
       return true;
     }
-    // 2. 只有一个为空值
-    if(is_type<std::nullptr_t>(left) || is_type<std::nullptr_t>(right))
+    // 2. 数字按值比较, 0 == -0, NaN 不等于自己
+    if(left.is_number() && right.is_number())
     {
-      return false;
+      return left.as_number() == right.as_number();
     }
-    // 3. 类型不同
-    if(left.type() != right.type())
+    // 3. 字符串都驻留过, 内容相同编号就相同
+    if(left.is_symbol() && right.is_symbol())
     {
-      return false;
-    }
-    // 4. 类型相同，比较值
-    // 为了支持多种类型，这里需要针对具体类型进行 any_cast 并比较
-    // 示例：假设支持 int、double、std::string 类型
-    try
-    {
-      if(is_type<double>(left))
-      {
-        return std::any_cast<double>(left) == std::any_cast<double>(right);
-      }
-      if(is_type<std::string>(left))
-      {
-        return std::any_cast<std::string>(left) ==
-               std::any_cast<std::string>(right);
-      }
-      // 可以根据需要添加更多类型支持
-      // 如果类型不支持比较，抛出异常或返回 false
-      return false;
-    }
-    catch(const std::bad_any_cast &)
-    {
-      return false; // 转换失败时返回 false
+      return left.as_symbol() == right.as_symbol();
     }
-  }
-
-  template <typename T>
-  bool
-  is_type(const std::any &any)
-  {
-    return any.type() == typeid(T);
+    // 4. 类型不同, 或者是不支持比较的类型(布尔值)
+    return false;
   }
 
   void
-  check_number_operand(const Token &token, const std::any &operand)
+  check_number_operand(const Token &token,
+                       Value operand,
+                       const char *message = "oprand must be a number!")
   {
-    if(is_type<double>(operand))
+    if(operand.is_number())
     {
       return;
     }
 
-    throw Error::RuntimeError(token, "oprand must be a number!");
+    throw Error::RuntimeError(token, message);
   }
 
   void
-  check_number_operand(const Token &token,
-                       const std::any &left,
-                       const std::any &right)
+  check_number_operand(const Token &token, Value left, Value right)
   {
-    if(is_type<double>(left) && is_type<double>(right))
+    if(left.is_number() && right.is_number())
     {
       return;
     }
@@ -279,12 +476,17 @@ private:
   void
   runtime_error(const Error::RuntimeError &rerr)
   {
-    std::cout << std::format("{} [line:{}]\n",
+    Location location = lines_->locate(rerr._token);
+    std::cout << std::format("{} [line:{}, column:{}]\n",
                              rerr.what(),
-                             rerr._token.get_line());
+                             location.line,
+                             location.column);
     had_runtime_error_ = true;
   }
 
+  SymbolTable *symbols_;
+  const LineIndex *lines_;
+  std::unordered_map<const void *, Value> memo_;
   bool had_runtime_error_{false};
   bool had_error_{false};
 };
@@ -0,0 +1,388 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "frontend/include/ast.hh"
+#include "frontend/include/symbol_table.hh"
+#include "frontend/include/token.hh"
+#include "interpreter/include/value.hh"
+
+namespace beacon_lox
+{
+// 表达式的 SSA 形式: 一个 IrFunction 对应一个顶层表达式
+// 没有变量也没有控制流, 每条指令定义一个值, 值的编号就是指令的下标, 操作数总是指向前面的指令
+// 指令按后序排列, 和树上求值的顺序相同, 第一条出错的指令就是树上第一个出错的节点
+// 括号在降低时去掉
+
+// 值的静态类型, 运行时的值只会是对应的类型或者出错
+// ANY 只出现在操作数类型不确定的加法上, 结果是数字或者字符串
+enum class IrType : std::uint8_t
+{
+  NIL,
+  BOOL,
+  NUMBER,
+  STRING,
+  ANY,
+};
+
+enum class IrOp : std::uint8_t
+{
+  CONST,
+  NEG,
+  NOT,
+  ADD,
+  SUB,
+  MUL,
+  DIV,
+  EQ,
+  NE,
+  GT,
+  GE,
+  LT,
+  LE,
+};
+
+using IrValue = std::uint32_t;
+inline constexpr IrValue kNoValue = 0xffffffffU;
+
+struct IrInst
+{
+  IrOp op;
+  IrType type;
+  IrValue lhs{kNoValue};
+  IrValue rhs{kNoValue};
+  // CONST 的值
+  Value constant;
+  // 运算符的 token, 只用于报告运行时错误
+  Token token;
+};
+
+struct IrFunction
+{
+  std::vector<IrInst> insts;
+  IrValue result{kNoValue};
+};
+
+inline constexpr std::string_view
+ir_name(IrOp op)
+{
+  constexpr std::string_view names[] = {
+      "const", "neg", "not", "add", "sub", "mul", "div",
+      "eq",    "ne",  "gt",  "ge",  "lt",  "le"};
+  return names[static_cast<std::size_t>(op)];
+}
+
+inline constexpr std::string_view
+ir_name(IrType type)
+{
+  constexpr std::string_view names[] = {
+      "nil", "bool", "number", "string", "any"};
+  return names[static_cast<std::size_t>(type)];
+}
+
+inline constexpr bool
+is_unary(IrOp op)
+{
+  return op == IrOp::NEG || op == IrOp::NOT;
+}
+
+inline constexpr bool
+is_binary(IrOp op)
+{
+  return op != IrOp::CONST && !is_unary(op);
+}
+
+inline IrOp
+ir_op(UnaryOp op)
+{
+  return op == UnaryOp::MINUS ? IrOp::NEG : IrOp::NOT;
+}
+
+inline IrOp
+ir_op(BinaryOp op)
+{
+  switch(op)
+  {
+    case BinaryOp::PLUS:
+      return IrOp::ADD;
+    case BinaryOp::MINUS:
+      return IrOp::SUB;
+    case BinaryOp::STAR:
+      return IrOp::MUL;
+    case BinaryOp::SLASH:
+      return IrOp::DIV;
+    case BinaryOp::EQUAL_EQUAL:
+      return IrOp::EQ;
+    case BinaryOp::BANG_EQUAL:
+      return IrOp::NE;
+    case BinaryOp::GREATER:
+      return IrOp::GT;
+    case BinaryOp::GREATER_EQUAL:
+      return IrOp::GE;
+    case BinaryOp::LESS:
+      return IrOp::LT;
+    case BinaryOp::LESS_EQUAL:
+      return IrOp::LE;
+  }
+  return IrOp::ADD;
+}
+
+inline UnaryOp
+unary_op(IrOp op)
+{
+  return op == IrOp::NEG ? UnaryOp::MINUS : UnaryOp::BANS;
+}
+
+inline BinaryOp
+binary_op(IrOp op)
+{
+  switch(op)
+  {
+    case IrOp::SUB:
+      return BinaryOp::MINUS;
+    case IrOp::MUL:
+      return BinaryOp::STAR;
+    case IrOp::DIV:
+      return BinaryOp::SLASH;
+    case IrOp::EQ:
+      return BinaryOp::EQUAL_EQUAL;
+    case IrOp::NE:
+      return BinaryOp::BANG_EQUAL;
+    case IrOp::GT:
+      return BinaryOp::GREATER;
+    case IrOp::GE:
+      return BinaryOp::GREATER_EQUAL;
+    case IrOp::LT:
+      return BinaryOp::LESS;
+    case IrOp::LE:
+      return BinaryOp::LESS_EQUAL;
+    default:
+      return BinaryOp::PLUS;
+  }
+}
+
+inline IrType
+constant_type(Value value)
+{
+  if(value.is_number())
+  {
+    return IrType::NUMBER;
+  }
+  if(value.is_bool())
+  {
+    return IrType::BOOL;
+  }
+  if(value.is_symbol())
+  {
+    return IrType::STRING;
+  }
+  return IrType::NIL;
+}
+
+// 运算成功时结果的类型
+inline IrType
+result_type(IrOp op, IrType lhs, IrType rhs)
+{
+  switch(op)
+  {
+    case IrOp::NEG:
+    case IrOp::SUB:
+    case IrOp::MUL:
+    case IrOp::DIV:
+      return IrType::NUMBER;
+    case IrOp::ADD:
+      if(lhs == rhs && (lhs == IrType::NUMBER || lhs == IrType::STRING))
+      {
+        return lhs;
+      }
+      return IrType::ANY;
+    default:
+      return IrType::BOOL;
+  }
+}
+
+// 运行时会不会出错: 数字运算的操作数不全是数字, 或者加法的两边不确定是同一种类型
+// 会出错的指令即使结果没有用到也不能删掉
+inline bool
+may_fail(const IrFunction &fn, const IrInst &inst)
+{
+  auto type = [&fn](IrValue value) { return fn.insts[value].type; };
+  switch(inst.op)
+  {
+    case IrOp::CONST:
+    case IrOp::NOT:
+    case IrOp::EQ:
+    case IrOp::NE:
+      return false;
+    case IrOp::NEG:
+      return type(inst.lhs) != IrType::NUMBER;
+    case IrOp::ADD:
+      return result_type(IrOp::ADD, type(inst.lhs), type(inst.rhs)) ==
+             IrType::ANY;
+    default:
+      return type(inst.lhs) != IrType::NUMBER ||
+             type(inst.rhs) != IrType::NUMBER;
+  }
+}
+
+// 把一个表达式降低成 SSA, 没有驻留的字符串字面量驻留在 symbols 里
+// 和 FlatAst 一样用显式的栈做后序遍历
+// 哈希共享的运算节点只降低一次, 之后的父节点直接用它的值, 不展开成树
+inline IrFunction
+lower(const Expr &root, SymbolTable &symbols)
+{
+  IrFunction fn;
+  struct Frame
+  {
+    Expr expr;
+    bool expanded;
+  };
+  std::vector<Frame> stack{{root, false}};
+  std::vector<IrValue> done;
+  std::unordered_map<const void *, IrValue> memo;
+  auto emit = [&fn, &done](IrInst inst)
+  {
+    done.push_back(static_cast<IrValue>(fn.insts.size()));
+    fn.insts.push_back(std::move(inst));
+  };
+  auto pop = [&done]
+  {
+    IrValue value = done.back();
+    done.pop_back();
+    return value;
+  };
+  while(!stack.empty())
+  {
+    Frame frame = stack.back();
+    stack.pop_back();
+    const void *node = shared_node(frame.expr);
+    if(auto it = memo.find(node);
+       !frame.expanded && node != nullptr && it != memo.end())
+    {
+      done.push_back(it->second);
+      continue;
+    }
+    if(auto *const *binary = std::get_if<BinaryExprPtr>(&frame.expr))
+    {
+      if(!frame.expanded)
+      {
+        stack.push_back({frame.expr, true});
+        stack.push_back({(*binary)->right, false});
+        stack.push_back({(*binary)->left, false});
+        continue;
+      }
+      IrValue rhs = pop();
+      IrValue lhs = pop();
+      IrOp op = ir_op((*binary)->op);
+      emit({op,
+            result_type(op, fn.insts[lhs].type, fn.insts[rhs].type),
+            lhs,
+            rhs,
+            {},
+            (*binary)->token});
+    }
+    else if(auto *const *unary = std::get_if<UnaryExprPtr>(&frame.expr))
+    {
+      if(!frame.expanded)
+      {
+        stack.push_back({frame.expr, true});
+        stack.push_back({(*unary)->expr, false});
+        continue;
+      }
+      IrOp op = ir_op((*unary)->op);
+      emit({op,
+            result_type(op, IrType::ANY, IrType::ANY),
+            pop(),
+            kNoValue,
+            {},
+            (*unary)->token});
+    }
+    else if(auto *const *group = std::get_if<GroupingExprPtr>(&frame.expr))
+    {
+      stack.push_back({(*group)->expr, false});
+    }
+    else
+    {
+      const LiteralExpr *literal = std::get<LiteralExprPtr>(frame.expr);
+      Value value = std::visit(
+          [&symbols, literal](const auto &v) -> Value
+          {
+            using T = std::decay_t<decltype(v)>;
+            if constexpr(std::is_same_v<T, std::string_view>)
+            {
+              return Symbol{literal->symbol != kNoSymbol ? literal->symbol
+                                                         : symbols.intern(v)};
+            }
+            else
+            {
+              return v;
+            }
+          },
+          literal->literal);
+      IrType type = constant_type(value);
+      emit({IrOp::CONST, type, kNoValue, kNoValue, value, {}});
+    }
+    // 只有运算节点会第二次出栈, 这时它的值刚放进 done
+    if(frame.expanded && node != nullptr)
+    {
+      memo.emplace(node, done.back());
+    }
+  }
+  fn.result = done.back();
+  return fn;
+}
+
+// 常量的文本形式, 字符串加上引号
+inline std::string
+constant_text(Value value, const SymbolTable &symbols)
+{
+  if(value.is_number())
+  {
+    return std::format("{}", value.as_number());
+  }
+  if(value.is_bool())
+  {
+    return value.as_bool() ? "true" : "false";
+  }
+  if(value.is_symbol())
+  {
+    return std::format("\"{}\"", symbols.name(value.as_symbol().id));
+  }
+  return "nil";
+}
+
+// 每条指令一行:
+//   %2 = add number %0, %1
+//   ret %2
+inline std::string
+print(const IrFunction &fn, const SymbolTable &symbols)
+{
+  std::string text;
+  for(std::size_t i = 0; i < fn.insts.size(); ++i)
+  {
+    const IrInst &inst = fn.insts[i];
+    text += std::format("%{} = {} {}", i, ir_name(inst.op), ir_name(inst.type));
+    if(inst.op == IrOp::CONST)
+    {
+      text += " " + constant_text(inst.constant, symbols);
+    }
+    else if(is_unary(inst.op))
+    {
+      text += std::format(" %{}", inst.lhs);
+    }
+    else
+    {
+      text += std::format(" %{}, %{}", inst.lhs, inst.rhs);
+    }
+    text += "\n";
+  }
+  text += std::format("ret %{}\n", fn.result);
+  return text;
+}
+} // namespace beacon_lox
@@ -0,0 +1,455 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "frontend/include/error.hh"
+#include "frontend/include/line_index.hh"
+#include "frontend/include/symbol_table.hh"
+#include "interpreter/include/interpreter.hh"
+#include "interpreter/include/ir.hh"
+
+namespace beacon_lox
+{
+// SSA 上的优化, 每个 pass 返回改动的指令数
+// 约定: 被替换掉的指令先留在原处, 由 DeadCodeElimination 统一删除
+// 会出错的指令(见 may_fail)不能删, 也不能被替换成别的值, 否则错误会消失或者换了位置
+class IrPass
+{
+public:
+  virtual ~IrPass() = default;
+
+  [[nodiscard]] virtual std::string_view
+  name() const = 0;
+
+  virtual std::size_t
+  run(IrFunction &fn) = 0;
+};
+
+// 只保留 keep 为 true 的指令并重新编号, 保留的指令的操作数也必须是保留的
+inline void
+compact(IrFunction &fn, const std::vector<bool> &keep)
+{
+  std::vector<IrValue> index(fn.insts.size(), kNoValue);
+  std::vector<IrInst> insts;
+  for(std::size_t i = 0; i < fn.insts.size(); ++i)
+  {
+    if(!keep[i])
+    {
+      continue;
+    }
+    IrInst &inst = fn.insts[i];
+    if(inst.lhs != kNoValue)
+    {
+      inst.lhs = index[inst.lhs];
+    }
+    if(inst.rhs != kNoValue)
+    {
+      inst.rhs = index[inst.rhs];
+    }
+    index[i] = static_cast<IrValue>(insts.size());
+    insts.push_back(std::move(inst));
+  }
+  fn.insts = std::move(insts);
+  fn.result = index[fn.result];
+}
+
+// 操作数都是常量的运算直接算出来, 运算规则借用 Interpreter, 和运行时的结果一定相同
+// 会出错的运算保持原样, 错误留到运行时报告
+// 拼接出的字符串驻留在 symbols 里, 应该是求值时用的那个表
+class ConstantPropagation : public IrPass
+{
+public:
+  explicit ConstantPropagation(SymbolTable &symbols)
+    : lines_(std::string_view{})
+    , eval_(symbols, lines_)
+  {}
+
+  [[nodiscard]] std::string_view
+  name() const override
+  {
+    return "constant-propagation";
+  }
+
+  std::size_t
+  run(IrFunction &fn) override
+  {
+    std::size_t changed = 0;
+    for(IrInst &inst : fn.insts)
+    {
+      if(inst.op == IrOp::CONST || !is_constant(fn, inst.lhs) ||
+         (is_binary(inst.op) && !is_constant(fn, inst.rhs)))
+      {
+        continue;
+      }
+      try
+      {
+        Value value =
+            is_unary(inst.op)
+                ? eval_.apply_unary(unary_op(inst.op),
+                                    inst.token,
+                                    fn.insts[inst.lhs].constant)
+                : eval_.apply_binary(binary_op(inst.op),
+                                     inst.token,
+                                     fn.insts[inst.lhs].constant,
+                                     fn.insts[inst.rhs].constant);
+        inst.op = IrOp::CONST;
+        inst.type = constant_type(value);
+        inst.lhs = kNoValue;
+        inst.rhs = kNoValue;
+        inst.constant = value;
+        ++changed;
+      }
+      catch(const Error::RuntimeError &)
+      {
+      }
+    }
+    return changed;
+  }
+
+private:
+  static bool
+  is_constant(const IrFunction &fn, IrValue value)
+  {
+    return fn.insts[value].op == IrOp::CONST;
+  }
+
+  // 折叠时的错误都被吞掉, 用不到真正的行首表
+  LineIndex lines_;
+  Interpreter eval_;
+};
+
+// 代数化简, 只用对所有可能的值都成立的恒等式:
+//   x - 0, x * 1, 1 * x, x / 1, -(-x)  => x  (x 是数字)
+//   !!x                                => x  (x 是布尔值)
+//   x == x, x != x                     => true, false  (x 是字符串或 nil)
+// x + 0 不能化简(-0 + 0 是 +0), x * 0 和 x - x 也不行(NaN, 无穷大)
+// 布尔值的 x == x 是 false(见 Interpreter::is_equal), 数字有 NaN, 都不化简
+class AlgebraicSimplification : public IrPass
+{
+public:
+  [[nodiscard]] std::string_view
+  name() const override
+  {
+    return "algebraic-simplification";
+  }
+
+  std::size_t
+  run(IrFunction &fn) override
+  {
+    std::size_t changed = 0;
+    std::vector<IrValue> replace(fn.insts.size());
+    for(std::size_t i = 0; i < fn.insts.size(); ++i)
+    {
+      replace[i] = static_cast<IrValue>(i);
+      IrInst &inst = fn.insts[i];
+      if(inst.lhs != kNoValue)
+      {
+        inst.lhs = replace[inst.lhs];
+      }
+      if(inst.rhs != kNoValue)
+      {
+        inst.rhs = replace[inst.rhs];
+      }
+      if(simplify(fn, inst, replace[i]))
+      {
+        ++changed;
+      }
+    }
+    fn.result = replace[fn.result];
+    return changed;
+  }
+
+private:
+  // 化简成已有的值时把它写进 replace, 化简成常量时直接改写 inst
+  static bool
+  simplify(IrFunction &fn, IrInst &inst, IrValue &replace)
+  {
+    auto type = [&fn](IrValue value) { return fn.insts[value].type; };
+    // 按位比较, -0 不能当成 0: x 是 -0 时 x - (-0) 是 +0
+    auto is_number = [&fn](IrValue value, double expect)
+    {
+      const IrInst &operand = fn.insts[value];
+      return operand.op == IrOp::CONST &&
+             operand.constant.bits() == Value(expect).bits();
+    };
+    switch(inst.op)
+    {
+      case IrOp::SUB:
+        if(type(inst.lhs) == IrType::NUMBER && is_number(inst.rhs, 0))
+        {
+          replace = inst.lhs;
+          return true;
+        }
+        break;
+      case IrOp::MUL:
+        if(type(inst.lhs) == IrType::NUMBER && is_number(inst.rhs, 1))
+        {
+          replace = inst.lhs;
+          return true;
+        }
+        if(type(inst.rhs) == IrType::NUMBER && is_number(inst.lhs, 1))
+        {
+          replace = inst.rhs;
+          return true;
+        }
+        break;
+      case IrOp::DIV:
+        if(type(inst.lhs) == IrType::NUMBER && is_number(inst.rhs, 1))
+        {
+          replace = inst.lhs;
+          return true;
+        }
+        break;
+      case IrOp::NEG:
+      case IrOp::NOT:
+      {
+        const IrInst &operand = fn.insts[inst.lhs];
+        IrType expect = inst.op == IrOp::NEG ? IrType::NUMBER : IrType::BOOL;
+        if(operand.op == inst.op && type(operand.lhs) == expect)
+        {
+          replace = operand.lhs;
+          return true;
+        }
+        break;
+      }
+      case IrOp::EQ:
+      case IrOp::NE:
+        if(inst.lhs == inst.rhs && (type(inst.lhs) == IrType::STRING ||
+                                    type(inst.lhs) == IrType::NIL))
+        {
+          inst.constant = inst.op == IrOp::EQ;
+          inst.op = IrOp::CONST;
+          inst.type = IrType::BOOL;
+          inst.lhs = kNoValue;
+          inst.rhs = kNoValue;
+          return true;
+        }
+        break;
+      default:
+        break;
+    }
+    return false;
+  }
+};
+
+// 公共子表达式消除: 运算符和操作数都相同的指令只算一次, 常量按值合并
+// 重复的指令在前一条之后执行, 前一条出错时它根本不会执行, 所以会出错的指令也可以合并
+// 乘法和相等比较的两个操作数可以交换
+class CommonSubexpressionElimination : public IrPass
+{
+public:
+  [[nodiscard]] std::string_view
+  name() const override
+  {
+    return "common-subexpression-elimination";
+  }
+
+  std::size_t
+  run(IrFunction &fn) override
+  {
+    std::unordered_map<Key, IrValue, KeyHash> seen;
+    std::vector<IrValue> replace(fn.insts.size());
+    std::vector<bool> keep(fn.insts.size(), true);
+    std::size_t changed = 0;
+    for(std::size_t i = 0; i < fn.insts.size(); ++i)
+    {
+      IrInst &inst = fn.insts[i];
+      if(inst.lhs != kNoValue)
+      {
+        inst.lhs = replace[inst.lhs];
+      }
+      if(inst.rhs != kNoValue)
+      {
+        inst.rhs = replace[inst.rhs];
+      }
+      auto [it, inserted] =
+          seen.try_emplace(key(inst), static_cast<IrValue>(i));
+      replace[i] = it->second;
+      if(!inserted)
+      {
+        keep[i] = false;
+        ++changed;
+      }
+    }
+    fn.result = replace[fn.result];
+    if(changed != 0)
+    {
+      compact(fn, keep);
+    }
+    return changed;
+  }
+
+private:
+  struct Key
+  {
+    IrOp op;
+    IrType type;
+    IrValue lhs;
+    IrValue rhs;
+    std::uint64_t bits;
+
+    bool
+    operator==(const Key &other) const = default;
+  };
+
+  struct KeyHash
+  {
+    std::size_t
+    operator()(const Key &key) const
+    {
+      std::uint64_t h =
+          (std::uint64_t{static_cast<std::uint8_t>(key.op)} << 8) |
+          static_cast<std::uint8_t>(key.type);
+      h = (h ^ key.lhs) * 0x9e3779b97f4a7c15ULL;
+      h = (h ^ key.rhs) * 0x9e3779b97f4a7c15ULL;
+      h = (h ^ key.bits) * 0x9e3779b97f4a7c15ULL;
+      return static_cast<std::size_t>(h ^ (h >> 32));
+    }
+  };
+
+  static Key
+  key(const IrInst &inst)
+  {
+    if(inst.op != IrOp::CONST)
+    {
+      IrValue lhs = inst.lhs;
+      IrValue rhs = inst.rhs;
+      bool commutative =
+          inst.op == IrOp::MUL || inst.op == IrOp::EQ || inst.op == IrOp::NE;
+      if(commutative && rhs < lhs)
+      {
+        std::swap(lhs, rhs);
+      }
+      return {inst.op, inst.type, lhs, rhs, 0};
+    }
+    // 按编码后的位比较: 0 和 -0 不合并, NaN 和自己合并
+    return {IrOp::CONST, inst.type, kNoValue, kNoValue, inst.constant.bits()};
+  }
+};
+
+// 删除结果没有用到并且不会出错的指令
+class DeadCodeElimination : public IrPass
+{
+public:
+  [[nodiscard]] std::string_view
+  name() const override
+  {
+    return "dead-code-elimination";
+  }
+
+  std::size_t
+  run(IrFunction &fn) override
+  {
+    std::vector<bool> live(fn.insts.size(), false);
+    live[fn.result] = true;
+    std::size_t removed = 0;
+    for(std::size_t i = fn.insts.size(); i-- > 0;)
+    {
+      const IrInst &inst = fn.insts[i];
+      if(!live[i] && !may_fail(fn, inst))
+      {
+        ++removed;
+        continue;
+      }
+      live[i] = true;
+      if(inst.lhs != kNoValue)
+      {
+        live[inst.lhs] = true;
+      }
+      if(inst.rhs != kNoValue)
+      {
+        live[inst.rhs] = true;
+      }
+    }
+    if(removed != 0)
+    {
+      compact(fn, live);
+    }
+    return removed;
+  }
+};
+
+// 按加入的顺序反复运行所有的 pass, 直到一轮里没有任何改动
+// 每个 pass 的改动次数和耗时都累计在 stats() 里
+class PassManager
+{
+public:
+  struct Stats
+  {
+    std::string_view name;
+    std::size_t changes{0};
+    double seconds{0};
+  };
+
+  PassManager &
+  add(std::unique_ptr<IrPass> pass)
+  {
+    stats_.push_back({pass->name()});
+    passes_.push_back(std::move(pass));
+    return *this;
+  }
+
+  template <typename Pass, typename... Args>
+  PassManager &
+  add(Args &&...args)
+  {
+    return add(std::make_unique<Pass>(std::forward<Args>(args)...));
+  }
+
+  // 返回总的改动次数
+  std::size_t
+  run(IrFunction &fn, std::size_t max_rounds = 8)
+  {
+    std::size_t total = 0;
+    for(std::size_t round = 0; round < max_rounds; ++round)
+    {
+      std::size_t changed = 0;
+      for(std::size_t i = 0; i < passes_.size(); ++i)
+      {
+        auto begin = std::chrono::steady_clock::now();
+        std::size_t n = passes_[i]->run(fn);
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - begin;
+        stats_[i].changes += n;
+        stats_[i].seconds += elapsed.count();
+        changed += n;
+      }
+      total += changed;
+      if(changed == 0)
+      {
+        break;
+      }
+    }
+    return total;
+  }
+
+  [[nodiscard]] const std::vector<Stats> &
+  stats() const
+  {
+    return stats_;
+  }
+
+  // 默认的流水线: 先算出常量, 再化简和合并, 最后删掉没用的指令
+  static PassManager
+  standard(SymbolTable &symbols)
+  {
+    PassManager manager;
+    manager.add<ConstantPropagation>(symbols)
+        .add<AlgebraicSimplification>()
+        .add<CommonSubexpressionElimination>()
+        .add<DeadCodeElimination>();
+    return manager;
+  }
+
+private:
+  std::vector<std::unique_ptr<IrPass>> passes_;
+  std::vector<Stats> stats_;
+};
+} // namespace beacon_lox
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "frontend/include/ast.hh"
+#include "interpreter/include/ir.hh"
+
+namespace beacon_lox
+{
+// AST 上的类型推导, 类型和 IR 用的是同一套(IrType, result_type)
+// 字面量的类型是已知的, 数字运算的结果一定是数字, 比较的结果一定是布尔值
+// 两个操作数都证明是数字的一元负号和二元运算标上 numeric, 解释器对它们走不检查类型的路径
+// 证明不了的节点保持原样, 运行时仍然检查, 错误信息和位置都不变
+// 运算出错时整个表达式就停下了, 所以 "成功时的类型" 足以证明父节点的操作数类型
+// 哈希共享的节点按地址记住推导过的类型, 每个不同的子树只推导一次
+class TypeInference
+{
+public:
+  // 返回整个表达式的类型
+  IrType
+  infer(const Expr &root)
+  {
+    // 和 ConstantFolder 一样用显式的栈做后序遍历
+    struct Frame
+    {
+      Expr expr;
+      bool expanded;
+    };
+    std::vector<Frame> stack{{root, false}};
+    std::vector<IrType> done;
+    // 共享的子树只推导一次, 再遇到时直接用记下的类型
+    std::unordered_map<const void *, IrType> memo;
+    while(!stack.empty())
+    {
+      Frame frame = stack.back();
+      stack.pop_back();
+      const void *node = shared_node(frame.expr);
+      if(!frame.expanded)
+      {
+        if(auto it = memo.find(node); node != nullptr && it != memo.end())
+        {
+          done.push_back(it->second);
+          continue;
+        }
+        stack.push_back({frame.expr, true});
+        if(auto *const *binary = std::get_if<BinaryExprPtr>(&frame.expr))
+        {
+          stack.push_back({(*binary)->right, false});
+          stack.push_back({(*binary)->left, false});
+        }
+        else if(auto *const *unary = std::get_if<UnaryExprPtr>(&frame.expr))
+        {
+          stack.push_back({(*unary)->expr, false});
+        }
+        else if(auto *const *group = std::get_if<GroupingExprPtr>(&frame.expr))
+        {
+          stack.push_back({(*group)->expr, false});
+        }
+        continue;
+      }
+      done.push_back(infer_node(frame.expr, done));
+      if(node != nullptr)
+      {
+        memo.emplace(node, done.back());
+      }
+    }
+    return done.back();
+  }
+
+  // 标上 numeric 的节点数
+  [[nodiscard]] std::size_t
+  proven() const
+  {
+    return proven_;
+  }
+
+private:
+  // 子节点的类型在 done 的栈顶
+  IrType
+  infer_node(const Expr &expr, std::vector<IrType> &done)
+  {
+    if(auto *const *binary = std::get_if<BinaryExprPtr>(&expr))
+    {
+      IrType right = pop(done);
+      IrType left = pop(done);
+      if(left == IrType::NUMBER && right == IrType::NUMBER)
+      {
+        mark((*binary)->numeric);
+      }
+      return result_type(ir_op((*binary)->op), left, right);
+    }
+    if(auto *const *unary = std::get_if<UnaryExprPtr>(&expr))
+    {
+      IrType operand = pop(done);
+      if((*unary)->op == UnaryOp::MINUS && operand == IrType::NUMBER)
+      {
+        mark((*unary)->numeric);
+      }
+      return result_type(ir_op((*unary)->op), operand, IrType::ANY);
+    }
+    if(std::holds_alternative<GroupingExprPtr>(expr))
+    {
+      return pop(done);
+    }
+    return std::visit(
+        [](const auto &value)
+        {
+          using T = std::decay_t<decltype(value)>;
+          if constexpr(std::is_same_v<T, double>)
+          {
+            return IrType::NUMBER;
+          }
+          else if constexpr(std::is_same_v<T, bool>)
+          {
+            return IrType::BOOL;
+          }
+          else if constexpr(std::is_same_v<T, std::string_view>)
+          {
+            return IrType::STRING;
+          }
+          else
+          {
+            return IrType::NIL;
+          }
+        },
+        std::get<LiteralExprPtr>(expr)->literal);
+  }
+
+  void
+  mark(bool &numeric)
+  {
+    // 同一棵 DAG 再推导一次时节点已经标过了, 不重复计数
+    if(!numeric)
+    {
+      numeric = true;
+      ++proven_;
+    }
+  }
+
+  static IrType
+  pop(std::vector<IrType> &done)
+  {
+    IrType type = done.back();
+    done.pop_back();
+    return type;
+  }
+
+  std::size_t proven_{0};
+};
+} // namespace beacon_lox
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "frontend/include/symbol_table.hh"
+
+namespace beacon_lox
+{
+// 解释器的运行时值, 8 字节, 用 NaN-boxing 编码:
+//   数字      double 本身的位
+//   nil/布尔  quiet NaN 加上低位的标记
+//   字符串    符号位 + quiet NaN, 低 32 位是驻留编号
+// 字符串都驻留在 SymbolTable 里, 值里只放编号, 不需要指向堆的指针, 拷贝就是拷贝 8 个字节
+// 运算产生的 NaN 统一成一个标准的 NaN, 保证不会和上面的标记冲突
+class Value
+{
+public:
+  Value()
+    : bits_(kNil)
+  {}
+
+  Value(std::nullptr_t)
+    : bits_(kNil)
+  {}
+
+  Value(bool value)
+    : bits_(value ? kTrue : kFalse)
+  {}
+
+  Value(double value)
+    : bits_(std::isnan(value) ? kCanonicalNaN
+                              : std::bit_cast<std::uint64_t>(value))
+  {}
+
+  Value(Symbol symbol)
+    : bits_(kSymbol | symbol.id)
+  {}
+
+  // 指针会被隐式转换成 bool, 不允许
+  Value(const void *) = delete;
+
+  [[nodiscard]] bool
+  is_number() const
+  {
+    return (bits_ & kQuietNaN) != kQuietNaN;
+  }
+
+  [[nodiscard]] bool
+  is_nil() const
+  {
+    return bits_ == kNil;
+  }
+
+  [[nodiscard]] bool
+  is_bool() const
+  {
+    return (bits_ | 1) == kTrue;
+  }
+
+  [[nodiscard]] bool
+  is_symbol() const
+  {
+    return (bits_ & kSymbol) == kSymbol;
+  }
+
+  // 下面的取值函数不检查类型, 调用前先用 is_xxx 判断
+  [[nodiscard]] double
+  as_number() const
+  {
+    return std::bit_cast<double>(bits_);
+  }
+
+  [[nodiscard]] bool
+  as_bool() const
+  {
+    return bits_ == kTrue;
+  }
+
+  [[nodiscard]] Symbol
+  as_symbol() const
+  {
+    return Symbol{static_cast<SymbolId>(bits_)};
+  }
+
+  // 编码后的位, 相同的值位也相同(数字的 0 和 -0 除外)
+  [[nodiscard]] std::uint64_t
+  bits() const
+  {
+    return bits_;
+  }
+
+private:
+  static constexpr std::uint64_t kSignBit = 0x8000000000000000ULL;
+  static constexpr std::uint64_t kQuietNaN = 0x7ffc000000000000ULL;
+  static constexpr std::uint64_t kCanonicalNaN = 0x7ff8000000000000ULL;
+  static constexpr std::uint64_t kNil = kQuietNaN | 1;
+  static constexpr std::uint64_t kFalse = kQuietNaN | 2;
+  static constexpr std::uint64_t kTrue = kQuietNaN | 3;
+  static constexpr std::uint64_t kSymbol = kSignBit | kQuietNaN;
+
+  std::uint64_t bits_;
+};
+
+static_assert(sizeof(Value) == 8);
+} // namespace beacon_lox
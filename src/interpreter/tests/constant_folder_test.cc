@@ -0,0 +1,107 @@
+#include "frontend/include/ast.hh"
+#include "frontend/include/compilation_unit.hh"
+#include "interpreter/include/constant_folder.hh"
+#include "interpreter/include/interpreter.hh"
+#include "interpreter/include/ir.hh"
+
+#include <format>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+// 折叠后的树必须是预期的样子, 求值的结果和折叠前相同
+// 会出错的运算保持原样, 错误信息和它的行号列号都不变
+// 哈希共享的 DAG 上每个不同的节点只折叠一次
+
+
+std::string
+print(const beacon_lox::Expr &expr)
+{
+  return beacon_lox::ExprPrinter().visit(expr);
+}
+
+// 求值的结果或者错误, 错误带上出错的 token 的行号和列号
+std::string
+outcome(beacon_lox::CompilationUnit &unit, const beacon_lox::Expr &expr)
+{
+  beacon_lox::Interpreter inter(unit.symbols(), unit.lines());
+  try
+  {
+    return beacon_lox::constant_text(inter.evaluate(expr), unit.symbols());
+  }
+  catch(const beacon_lox::Error::RuntimeError &e)
+  {
+    auto at = unit.lines().locate(e._token);
+    return std::format("{} [line:{}, column:{}]",
+                       e.what(),
+                       at.line,
+                       at.column);
+  }
+}
+
+int
+main(int /*argc*/, char ** /*argv*/)
+{
+  int failed = 0;
+
+  struct Case
+  {
+    std::string_view source;
+    std::string_view folded;
+    std::string_view outcome;
+  };
+  const Case cases[] = {
+      {"(1 + 2) * 3 - -4 == 13", "(true)", "true"},
+      {"\"con\" + \"cat\" != \"concat\"", "(false)", "false"},
+      {"(1 + 2) * 3 + -\"a\"",
+       "(PLUS + (9.0) (MINUS - (a)))",
+       "unary minus must be number [line:1, column:15]"},
+      {"1 +\n  2 * -\"a\"",
+       "(PLUS + (1.0) (STAR * (2.0) (MINUS - (a))))",
+       "unary minus must be number [line:2, column:7]"},
+  };
+  for(const auto &c : cases)
+  {
+    auto unit = beacon_lox::CompilationUnit::from_string(c.source);
+    unit.parse();
+    beacon_lox::ConstantFolder folder(unit.symbols(), unit.arena());
+    const beacon_lox::Expr &expr = unit.exprs().front();
+    auto before = outcome(unit, expr);
+    auto folded = folder.fold(expr);
+    auto after = outcome(unit, folded);
+    if(print(folded) != c.folded || before != c.outcome || after != before)
+    {
+      std::cout << std::format("{}:\n  folded {}\n  want   {}\n"
+                               "  before {}\n  after  {}\n  want   {}\n",
+                               c.source,
+                               print(folded),
+                               c.folded,
+                               before,
+                               after,
+                               c.outcome);
+      ++failed;
+    }
+  }
+
+  // 2^12 条路径, 14 个不同的运算
+  std::string repeated = "(1 + 2 * 3)";
+  for(int i = 0; i < 12; ++i)
+  {
+    repeated = std::format("({} - {})", repeated, repeated);
+  }
+  auto dag_unit = beacon_lox::CompilationUnit::from_string(repeated);
+  dag_unit.enable_hash_consing();
+  dag_unit.parse();
+  beacon_lox::ConstantFolder dag_folder(dag_unit.symbols(), dag_unit.arena());
+  auto dag = dag_folder.fold(dag_unit.exprs().front());
+  if(print(dag) != "(0.0)" || dag_folder.folded() != 14)
+  {
+    std::cout << std::format("dag folded {} ops into {}\n",
+                             dag_folder.folded(),
+                             print(dag));
+    ++failed;
+  }
+
+  std::cout << (failed == 0 ? "all passed\n" : "FAILED\n");
+  return failed == 0 ? 0 : 1;
+}
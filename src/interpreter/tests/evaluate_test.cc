@@ -0,0 +1,241 @@
+#include "frontend/include/compilation_unit.hh"
+#include "frontend/include/flat_ast.hh"
+#include "frontend/include/program_cache.hh"
+#include "interpreter/include/interpreter.hh"
+#include "interpreter/include/ir.hh"
+#include "interpreter/include/type_inference.hh"
+#include "interpreter/include/value.hh"
+
+#include <unistd.h>
+
+#include <any>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <string_view>
+
+// 同一个表达式的几种求值方式, 结果或者错误(连同位置)都必须相同:
+//   静态分派的 evaluate, 兼容用的动态 Visitor, 扁平 AST, SSA, 类型推导之后,
+//   以及命中缓存时: 源码不扫描也不解析, 直接求值映射进来的扁平 AST
+// 类型推导的结果和证明的节点数也要是预期的值
+
+
+// 求值的结果或者错误, 错误带上出错的 token 的行号和列号
+template <typename Evaluate>
+std::string
+outcome(Evaluate evaluate, beacon_lox::CompilationUnit &unit)
+{
+  try
+  {
+    return beacon_lox::constant_text(evaluate(), unit.symbols());
+  }
+  catch(const beacon_lox::Error::RuntimeError &e)
+  {
+    auto at = unit.lines().locate(e._token);
+    return std::format("{} [line:{}, column:{}]",
+                       e.what(),
+                       at.line,
+                       at.column);
+  }
+}
+
+int
+main(int /*argc*/, char ** /*argv*/)
+{
+  int failed = 0;
+  const auto cache_dir = std::filesystem::temp_directory_path() /
+                         std::format("beacon_lox_evaluate_test_{}", ::getpid());
+  beacon_lox::ProgramCache cache(cache_dir.string());
+
+  struct Case
+  {
+    std::string_view source;
+    std::string_view outcome;
+    beacon_lox::IrType type;
+    std::size_t proven;
+  };
+  using beacon_lox::IrType;
+  const Case cases[] = {
+      {"(1 + 2) * -3 - 4 / (5 - 6) >= 2 * 2", "false", IrType::BOOL, 8},
+      {"-(\"a\") * 2 + 1",
+       "unary minus must be number [line:1, column:1]",
+       IrType::NUMBER,
+       2},
+      {"(1 + nil) * 2 < 3",
+       "oprand must be two strings! [line:1, column:4]",
+       IrType::BOOL,
+       1},
+      {"\"con\" + \"cat\" == \"concat\"", "true", IrType::BOOL, 0},
+      {"1 + \"a\"",
+       "oprand must be two strings! [line:1, column:3]",
+       IrType::ANY,
+       0},
+      // 布尔值之间的 == 总是 false, 见 Interpreter::is_equal
+      {"true == true", "false", IrType::BOOL, 0},
+      {"-(0)", "-0", IrType::NUMBER, 1},
+      {"0 / 0 != 0 / 0", "true", IrType::BOOL, 3},
+  };
+  for(const auto &c : cases)
+  {
+    auto unit = beacon_lox::CompilationUnit::from_string(c.source);
+    unit.parse();
+    const beacon_lox::Expr &expr = unit.exprs().front();
+    beacon_lox::Interpreter inter(unit.symbols(), unit.lines());
+
+    auto tree = outcome([&] { return inter.evaluate(expr); }, unit);
+    auto dynamic = outcome(
+        [&]
+        {
+          return std::any_cast<beacon_lox::Value>(
+              std::visit([&inter](const auto &value) -> std::any
+                         { return value->accept(&inter); },
+                         expr));
+        },
+        unit);
+    auto flat_ast = beacon_lox::FlatAst::from_tree(expr, unit.source());
+    auto flat = outcome([&] { return inter.evaluate(flat_ast); }, unit);
+    auto fn = beacon_lox::lower(expr, unit.symbols());
+    auto ir = outcome([&] { return inter.evaluate(fn); }, unit);
+
+    cache.store(unit.source(), unit.tokens(), flat_ast);
+    // 同样的源码, 一个新的编译单元, 不调用 scan 和 parse
+    auto hit_unit = beacon_lox::CompilationUnit::from_string(c.source);
+    auto cached = cache.load(hit_unit.source());
+    std::string hit = "miss";
+    if(cached && hit_unit.tokens().empty())
+    {
+      beacon_lox::Interpreter hit_inter(hit_unit.symbols(), hit_unit.lines());
+      hit = outcome([&] { return hit_inter.evaluate(cached->ast()); },
+                    hit_unit);
+    }
+
+    beacon_lox::TypeInference inference;
+    auto type = inference.infer(expr);
+    auto typed = outcome([&] { return inter.evaluate(expr); }, unit);
+
+    if(tree != c.outcome || dynamic != tree || flat != tree || ir != tree ||
+       hit != tree || typed != tree || type != c.type ||
+       inference.proven() != c.proven)
+    {
+      std::cout << std::format(
+          "{}:\n  tree {}\n  visitor {}\n  flat {}\n  ir {}\n  cache {}\n"
+          "  typed {}\n  want {}\n  type {}, {} proven, want {}, {}\n",
+          c.source,
+          tree,
+          dynamic,
+          flat,
+          ir,
+          hit,
+          typed,
+          c.outcome,
+          beacon_lox::ir_name(type),
+          inference.proven(),
+          beacon_lox::ir_name(c.type),
+          c.proven);
+      ++failed;
+    }
+  }
+
+  // 哈希共享不跨语句: 第二条语句出错的位置是它自己的, 不是第一条的
+  for(bool hash_consing : {false, true})
+  {
+    auto unit =
+        beacon_lox::CompilationUnit::from_string("\"a\" - 1;\n\n\"a\" - 1;");
+    if(hash_consing)
+    {
+      unit.enable_hash_consing();
+    }
+    unit.parse();
+    beacon_lox::Interpreter inter(unit.symbols(), unit.lines());
+    std::string tree;
+    std::string flat;
+    for(const auto &expr : unit.exprs())
+    {
+      tree += outcome([&] { return inter.evaluate(expr); }, unit) + "\n";
+      auto flat_ast = beacon_lox::FlatAst::from_tree(expr, unit.source());
+      flat += outcome([&] { return inter.evaluate(flat_ast); }, unit) + "\n";
+    }
+    const std::string_view expect =
+        "oprand must be two numbers! [line:1, column:5]\n"
+        "oprand must be two numbers! [line:3, column:5]\n";
+    if(tree != expect || flat != expect)
+    {
+      std::cout << std::format("statements, hash-consing {}:\n{}{}",
+                               hash_consing,
+                               tree,
+                               flat);
+      ++failed;
+    }
+  }
+
+  // 哈希共享的 DAG: 2^12 条路径, 扁平 AST 和 SSA 里每个不同的运算只有一份
+  // 求值的结果和出错的位置都和树上相同
+  struct DagCase
+  {
+    std::string_view base;
+    std::string_view outcome;
+    std::size_t flat_nodes;
+    std::size_t insts;
+  };
+  const DagCase dag_cases[] = {
+      {"(1 + 2 * 3)", "0", 42, 17},
+      {"(1 + -nil)", "unary minus must be number [line:1, column:18]", 41, 16},
+  };
+  for(const auto &c : dag_cases)
+  {
+    std::string repeated{c.base};
+    for(int i = 0; i < 12; ++i)
+    {
+      repeated = std::format("({} - {})", repeated, repeated);
+    }
+    auto unit = beacon_lox::CompilationUnit::from_string(repeated);
+    unit.enable_hash_consing();
+    unit.parse();
+    const beacon_lox::Expr &expr = unit.exprs().front();
+    beacon_lox::Interpreter inter(unit.symbols(), unit.lines());
+    auto tree = outcome([&] { return inter.evaluate(expr); }, unit);
+    auto flat_ast = beacon_lox::FlatAst::from_tree(expr, unit.source());
+    auto flat = outcome([&] { return inter.evaluate(flat_ast); }, unit);
+    auto fn = beacon_lox::lower(expr, unit.symbols());
+    auto ir = outcome([&] { return inter.evaluate(fn); }, unit);
+    if(tree != c.outcome || flat != tree || ir != tree ||
+       flat_ast.size() != c.flat_nodes || fn.insts.size() != c.insts)
+    {
+      std::cout << std::format("dag {}:\n  tree {}\n  flat {}\n  ir {}\n"
+                               "  want {}\n  {} flat nodes, {} insts, "
+                               "want {}, {}\n",
+                               c.base,
+                               tree,
+                               flat,
+                               ir,
+                               c.outcome,
+                               flat_ast.size(),
+                               fn.insts.size(),
+                               c.flat_nodes,
+                               c.insts);
+      ++failed;
+    }
+  }
+
+  // NaN-boxing 的编码: 每种值只有一种位模式, 取出来和放进去的相同
+  using beacon_lox::Value;
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  const double inf = std::numeric_limits<double>::infinity();
+  if(!Value().is_nil() || !Value(nullptr).is_nil() || !Value(true).as_bool() ||
+     Value(false).as_bool() || !Value(false).is_bool() ||
+     Value(-0.0).bits() == Value(0.0).bits() ||
+     Value(nan).bits() != Value(-nan).bits() || !Value(nan).is_number() ||
+     Value(-inf).as_number() != -inf ||
+     Value(beacon_lox::Symbol{7}).as_symbol().id != 7 ||
+     Value(beacon_lox::Symbol{7}).is_number() || Value(1.5).is_symbol())
+  {
+    std::cout << "Value encoding is wrong\n";
+    ++failed;
+  }
+
+  std::filesystem::remove_all(cache_dir);
+  std::cout << (failed == 0 ? "all passed\n" : "FAILED\n");
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,106 @@
+#include "frontend/include/compilation_unit.hh"
+#include "interpreter/include/constant_folder.hh"
+#include "interpreter/include/interpreter.hh"
+#include "interpreter/include/type_inference.hh"
+
+#include <any>
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <string>
+
+// 求值的耗时, 只打印时间, 不检查结果(结果由 constant_folder, evaluate 这些测试检查)
+// 不注册到 ctest
+
+
+// 同一个表达式反复求值 100000 次
+double
+time_evaluate(beacon_lox::Interpreter &inter, const beacon_lox::Expr &expr)
+{
+  auto begin = std::chrono::steady_clock::now();
+  for(int i = 0; i < 100000; ++i)
+  {
+    inter.evaluate(expr);
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - begin;
+  return elapsed.count();
+}
+
+int
+main(int /*argc*/, char ** /*argv*/)
+{
+  // 常量折叠前后
+  auto bench_unit = beacon_lox::CompilationUnit::from_string(
+      "(1 + 2) * 3 - -4 / (5 - 6) >= 2 * 2 == !false");
+  bench_unit.parse();
+  beacon_lox::Interpreter bench_inter(bench_unit.symbols(),
+                                      bench_unit.lines());
+  beacon_lox::Expr bench_expr = bench_unit.exprs().front();
+  double before = time_evaluate(bench_inter, bench_expr);
+
+  // 兼容用的动态接口: 根节点经过 accept 和 std::any
+  auto begin = std::chrono::steady_clock::now();
+  for(int i = 0; i < 100000; ++i)
+  {
+    std::visit([&bench_inter](const auto &value) -> std::any
+               { return value->accept(&bench_inter); },
+               bench_expr);
+  }
+  std::chrono::duration<double> dynamic =
+      std::chrono::steady_clock::now() - begin;
+
+  beacon_lox::ConstantFolder bench_folder(bench_unit.symbols(),
+                                          bench_unit.arena());
+  double after = time_evaluate(bench_inter, bench_folder.fold(bench_expr));
+  std::cout << std::format("100000 evaluations: {:.3f}s, through Visitor "
+                           "{:.3f}s, folded {:.3f}s\n",
+                           before,
+                           dynamic.count(),
+                           after);
+
+  // 类型推导前后
+  auto numeric_unit = beacon_lox::CompilationUnit::from_string(
+      "(1 + 2) * 3 - -4 / (5 - 6) >= 2 * 2 == (7 < 8 * 9)");
+  numeric_unit.parse();
+  beacon_lox::Interpreter numeric_inter(numeric_unit.symbols(),
+                                        numeric_unit.lines());
+  const beacon_lox::Expr &numeric_expr = numeric_unit.exprs().front();
+  double checked = time_evaluate(numeric_inter, numeric_expr);
+  beacon_lox::TypeInference numeric_inference;
+  numeric_inference.infer(numeric_expr);
+  std::cout << std::format("100000 evaluations: checked {:.3f}s, "
+                           "{} nodes proven {:.3f}s\n",
+                           checked,
+                           numeric_inference.proven(),
+                           time_evaluate(numeric_inter, numeric_expr));
+
+  // 重复的子表达式: 哈希共享后每个不同的子树只求值一次
+  std::string repeated = "(1 + 2 * 3)";
+  for(int i = 0; i < 12; ++i)
+  {
+    repeated = std::format("({} - {})", repeated, repeated);
+  }
+  auto tree_unit = beacon_lox::CompilationUnit::from_string(repeated);
+  tree_unit.parse();
+  auto dag_unit = beacon_lox::CompilationUnit::from_string(repeated);
+  dag_unit.enable_hash_consing();
+  dag_unit.parse();
+  auto time_interpret = [](beacon_lox::CompilationUnit &target)
+  {
+    beacon_lox::Interpreter target_inter(target.symbols(), target.lines());
+    auto begin = std::chrono::steady_clock::now();
+    target_inter.interpret(target.exprs().front());
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - begin;
+    return elapsed.count();
+  };
+  double tree_time = time_interpret(tree_unit);
+  double dag_time = time_interpret(dag_unit);
+  std::cout << std::format("tree {} bytes {:.4f}s, dag {} bytes {:.4f}s\n",
+                           tree_unit.ast_bytes(),
+                           tree_time,
+                           dag_unit.ast_bytes(),
+                           dag_time);
+  return 0;
+}
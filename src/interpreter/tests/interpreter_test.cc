@@ -1,40 +1,67 @@
-#include <sstream>
-#include <fstream>
-
-#include "frontend/include/parser.hh"
-#include "frontend/include/scanner.hh"
+#include "frontend/include/ast_dump.hh"
+#include "frontend/include/compilation_unit.hh"
+#include "frontend/include/flat_ast.hh"
+#include "frontend/include/program_cache.hh"
 #include "interpreter/include/interpreter.hh"
 
+#include <filesystem>
+#include <iterator>
+#include <thread>
+
 
 int
 main(int /*argc*/, char ** /*argv*/)
 {
   // std::string_view path{argv[1]};
-  std::stringstream ss;
-  std::fstream file("/workspace/crafting_interpreters/data/bea.lox");
-  if(!file.is_open())
+  auto unit = beacon_lox::CompilationUnit::open(
+      "/workspace/crafting_interpreters/data/bea.lox");
+  if(!unit.is_open())
   {
     return 65;
   }
-  ss << file.rdbuf();
-  beacon_lox::Scanner scanner{ss.str()};
-  auto tokens = scanner.scan_tokens();
 
-  for(const auto token : tokens)
+  // 源码没有变化时直接映射上次的结果, 不扫描也不解析, 求值之后就结束
+  // 只有没命中时才扫描, 解析, 再存进缓存
+  beacon_lox::ProgramCache cache(
+      (std::filesystem::temp_directory_path() / "beacon_lox_cache").string());
+  if(auto cached = cache.load(unit.source()))
+  {
+    std::cout << std::format("cache hit: {} tokens, {} nodes\n",
+                             cached->token_count(),
+                             cached->ast().size());
+    beacon_lox::Interpreter cached_inter(unit.symbols(), unit.lines());
+    cached_inter.interpret(cached->ast());
+    return cached_inter.had_runtime_error() ? 70 : 0;
+  }
+
+  unit.scan();
+
+  beacon_lox::dump_tokens(unit.tokens(),
+                          std::ostreambuf_iterator<char>(std::cout));
+
+  // 编译单元自己拥有源码, token 和 AST, 可以整个移交给另一个线程解析
+  std::thread worker([&unit] { unit.parse(); });
+  worker.join();
+  auto moved = std::move(unit);
+
+  if(!moved.diagnostics().empty())
   {
-    // std::cout << "format:" << token.get_lexeme() << "\n";
-    std::cout << std::format("{} {} {}\n",
-                             token.get_type(),
-                             token.get_lexeme(),
-                             token.get_literal());
+    beacon_lox::Error error;
+    moved.report(error);
+    for(const auto &err : error.errors())
+    {
+      std::cout << err;
+    }
+    return 65;
   }
 
+  cache.store(moved.source(),
+              moved.tokens(),
+              beacon_lox::FlatAst::from_trees(moved.exprs(), moved.source()));
 
-  beacon_lox::Parser par(tokens);
-  beacon_lox::Interpreter inter;
-  try
+  beacon_lox::Interpreter inter(moved.symbols(), moved.lines());
+  for(const auto &expr : moved.exprs())
   {
-    auto expr = par.parse();
     std::cout << "-------------------------\n";
 
     beacon_lox::ExprVisitor visitor;
@@ -50,21 +77,23 @@ main(int /*argc*/, char ** /*argv*/)
     // std::cout << "expr idx:" << expr.index() << "\n";
     inter.interpret(expr);
 
-    if(inter.had_runtime_error())
-    {
-      return 70;
-    }
-
-    if(inter.had_error())
-    {
-      return 65;
-    }
+    // 同一棵树转成扁平的后序数组再求值一次, 结果应该相同
+    auto flat = beacon_lox::FlatAst::from_tree(expr, moved.source());
+    std::cout << std::format("flat: {} nodes, {} bytes\n",
+                             flat.size(),
+                             flat.memory_bytes());
+    inter.interpret(flat);
   }
-  catch(const std::exception &e)
+
+  if(inter.had_runtime_error())
   {
-    std::cout << "exception: " << e.what() << "\n";
+    return 70;
   }
 
+  if(inter.had_error())
+  {
+    return 65;
+  }
 
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,247 @@
+#include "frontend/include/compilation_unit.hh"
+#include "interpreter/include/interpreter.hh"
+#include "interpreter/include/ir.hh"
+#include "interpreter/include/ir_passes.hh"
+
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// 降低到 SSA, 优化, 再求值, 结果和报错的位置都必须和树上求值相同
+// 然后逐个加入 pass, 看每个 pass 对求值时间的影响
+
+
+std::string
+show(beacon_lox::Value value, const beacon_lox::SymbolTable &symbols)
+{
+  return beacon_lox::constant_text(value, symbols);
+}
+
+// 求值的结果或者错误, 错误带上出错的 token 在源码里的位置
+template <typename Evaluate>
+std::string
+outcome(Evaluate evaluate, beacon_lox::CompilationUnit &unit)
+{
+  try
+  {
+    return show(evaluate(), unit.symbols());
+  }
+  catch(const beacon_lox::Error::RuntimeError &e)
+  {
+    return std::format("{} at {}",
+                       e.what(),
+                       e._token.get_lexeme().data() - unit.source().data());
+  }
+}
+
+// 随机表达式, 一部分子表达式会重复出现, 一部分会在运行时出错
+std::string
+random_expr(std::mt19937 &rng, int depth, std::vector<std::string> &seen)
+{
+  static const std::vector<std::string> atoms = {
+      "0", "1", "2", "2.5", "7", "\"a\"", "\"b\"", "true", "nil"};
+  static const std::vector<std::string> ops = {
+      " + ", " - ", " * ", " / ", " == ", " != ", " < ", " >= "};
+  int pick = static_cast<int>(rng() % 10);
+  if(depth == 0 || pick < 2)
+  {
+    // 数字多一些, 大部分运算能算出结果
+    return rng() % 3 == 0 ? atoms[rng() % atoms.size()] : atoms[rng() % 5];
+  }
+  if(pick < 4 && !seen.empty())
+  {
+    return seen[rng() % seen.size()];
+  }
+  std::string text;
+  if(pick < 5)
+  {
+    // 一元运算的操作数只能是 primary, 所以加上括号
+    text = std::format("{}({})",
+                       rng() % 2 == 0 ? "-" : "!",
+                       random_expr(rng, depth - 1, seen));
+  }
+  else
+  {
+    text = std::format("({}{}{})",
+                       random_expr(rng, depth - 1, seen),
+                       ops[rng() % ops.size()],
+                       random_expr(rng, depth - 1, seen));
+  }
+  seen.push_back(text);
+  return text;
+}
+
+int
+main(int /*argc*/, char ** /*argv*/)
+{
+  int failed = 0;
+
+  // 几个例子, 打印优化前后的 IR
+  for(std::string_view text :
+      {std::string_view{"-(-(3 - 0)) * 1 + (1 + 2) * (2 + 1)"},
+       std::string_view{"(\"a\" + \"b\" == \"ab\") != !(!(1 < 2))"},
+       std::string_view{"(-(\"x\") * 1 + 2) * (-(\"x\") * 1 + 2)"}})
+  {
+    auto unit = beacon_lox::CompilationUnit::from_string(text);
+    unit.parse();
+    auto fn = beacon_lox::lower(unit.exprs().front(), unit.symbols());
+    std::cout << std::format("{}\n{}", text, print(fn, unit.symbols()));
+    auto passes = beacon_lox::PassManager::standard(unit.symbols());
+    passes.run(fn);
+    std::cout << std::format("optimized:\n{}", print(fn, unit.symbols()));
+    beacon_lox::Interpreter inter(unit.symbols(), unit.lines());
+    inter.interpret(unit.exprs().front());
+    inter.interpret(fn);
+    std::cout << "\n";
+  }
+
+  // x - 0 化简成 x, x - (-0) 不能: x 是 -0 时结果是 +0
+  // 字面量都不是负数, 直接构造 -(0) - c, 只跑代数化简
+  for(double zero : {0.0, -0.0})
+  {
+    beacon_lox::SymbolTable symbols;
+    beacon_lox::IrFunction fn;
+    using beacon_lox::IrOp;
+    using beacon_lox::IrType;
+    using beacon_lox::kNoValue;
+    fn.insts.push_back(
+        {IrOp::CONST, IrType::NUMBER, kNoValue, kNoValue, 0.0, {}});
+    fn.insts.push_back({IrOp::NEG, IrType::NUMBER, 0, kNoValue, {}, {}});
+    fn.insts.push_back(
+        {IrOp::CONST, IrType::NUMBER, kNoValue, kNoValue, zero, {}});
+    fn.insts.push_back({IrOp::SUB, IrType::NUMBER, 1, 2, {}, {}});
+    fn.result = 3;
+    beacon_lox::LineIndex lines{std::string_view{}};
+    beacon_lox::Interpreter inter(symbols, lines);
+    auto expect = inter.evaluate(fn);
+    auto changes = beacon_lox::AlgebraicSimplification{}.run(fn);
+    auto got = inter.evaluate(fn);
+    if(got.bits() != expect.bits() || changes != (std::signbit(zero) ? 0 : 1))
+    {
+      std::cout << std::format("-0 - {}: {} changes\n{}",
+                               zero,
+                               changes,
+                               print(fn, symbols));
+      ++failed;
+    }
+  }
+
+  // 随机生成的规则库
+  std::mt19937 rng(7);
+  std::string corpus;
+  for(int i = 0; i < 2000; ++i)
+  {
+    std::vector<std::string> seen;
+    corpus += random_expr(rng, 6, seen) + ";\n";
+  }
+  auto unit = beacon_lox::CompilationUnit::from_string(corpus);
+  if(!unit.parse())
+  {
+    std::cout << "corpus has syntax errors\n";
+    return 1;
+  }
+  beacon_lox::Interpreter inter(unit.symbols(), unit.lines());
+
+  std::vector<beacon_lox::IrFunction> lowered;
+  std::vector<beacon_lox::IrFunction> optimized;
+  auto passes = beacon_lox::PassManager::standard(unit.symbols());
+  for(const auto &expr : unit.exprs())
+  {
+    lowered.push_back(beacon_lox::lower(expr, unit.symbols()));
+    optimized.push_back(lowered.back());
+    passes.run(optimized.back());
+  }
+  std::size_t errors = 0;
+  for(std::size_t i = 0; i < unit.exprs().size(); ++i)
+  {
+    auto expect =
+        outcome([&] { return inter.evaluate(unit.exprs()[i]); }, unit);
+    auto plain = outcome([&] { return inter.evaluate(lowered[i]); }, unit);
+    auto best = outcome([&] { return inter.evaluate(optimized[i]); }, unit);
+    errors += expect.find(" at ") != std::string::npos ? 1 : 0;
+    if(plain != expect || best != expect)
+    {
+      std::cout << std::format("expr {}: tree {}, ir {}, optimized {}\n{}",
+                               i,
+                               expect,
+                               plain,
+                               best,
+                               print(lowered[i], unit.symbols()));
+      ++failed;
+    }
+  }
+  for(const auto &stats : passes.stats())
+  {
+    std::cout << std::format("{:<34} {:>6} changes {:.4f}s\n",
+                             stats.name,
+                             stats.changes,
+                             stats.seconds);
+  }
+
+  // 每次多加一个 pass, 整个规则库求值 20 遍
+  auto count = [](const std::vector<beacon_lox::IrFunction> &fns)
+  {
+    std::size_t n = 0;
+    for(const auto &fn : fns)
+    {
+      n += fn.insts.size();
+    }
+    return n;
+  };
+  auto time_corpus = [&inter](const std::vector<beacon_lox::IrFunction> &fns)
+  {
+    auto begin = std::chrono::steady_clock::now();
+    for(int round = 0; round < 20; ++round)
+    {
+      for(const auto &fn : fns)
+      {
+        try
+        {
+          inter.evaluate(fn);
+        }
+        catch(const beacon_lox::Error::RuntimeError &)
+        {
+        }
+      }
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - begin;
+    return elapsed.count();
+  };
+  std::cout << std::format("{} exprs, {} runtime errors\n",
+                           unit.exprs().size(),
+                           errors);
+  std::cout << std::format("{:<34} {:>6} insts {:.4f}s\n",
+                           "none",
+                           count(lowered),
+                           time_corpus(lowered));
+  beacon_lox::PassManager prefix;
+  std::vector<std::unique_ptr<beacon_lox::IrPass>> pipeline;
+  pipeline.push_back(
+      std::make_unique<beacon_lox::ConstantPropagation>(unit.symbols()));
+  pipeline.push_back(std::make_unique<beacon_lox::AlgebraicSimplification>());
+  pipeline.push_back(
+      std::make_unique<beacon_lox::CommonSubexpressionElimination>());
+  pipeline.push_back(std::make_unique<beacon_lox::DeadCodeElimination>());
+  for(auto &pass : pipeline)
+  {
+    std::string_view name = pass->name();
+    prefix.add(std::move(pass));
+    auto fns = lowered;
+    for(auto &fn : fns)
+    {
+      prefix.run(fn);
+    }
+    std::cout << std::format("{:<34} {:>6} insts {:.4f}s\n",
+                             std::format("+ {}", name),
+                             count(fns),
+                             time_corpus(fns));
+  }
+
+  std::cout << (failed == 0 ? "all passed\n" : "FAILED\n");
+  return failed == 0 ? 0 : 1;
+}